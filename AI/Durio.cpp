@@ -8,6 +8,7 @@
 #include <random>
 #include <cassert>
 #include <cstdint>
+#include <chrono>
 
 namespace Durio {
 
@@ -39,7 +40,7 @@ public:
 private:
   template <typename T> T random_element(const vector<T>& v, mt19937& mt) const;
   int cmp_centrality(const vector<int>& lds, const vector<int>& rds) const;
-  MoveResult try_connect(const vector<vector<int>>& dist_mines) const;
+  MoveResult try_connect(const DistanceMatrix& dist_mines) const;
   MoveResult expand_tree() const;
 };
 
@@ -75,7 +76,8 @@ Durio::move() const {
   cerr << "\n===== Turn: " << history.size() + 1 << " =====" << endl;
 
   // compute distances among mines
-  vector<vector<int>> dist_mines, sp_prev_mines;
+  DistanceMatrix dist_mines;
+  vector<vector<int>> sp_prev_mines;
   calc_cur_dists(dist_mines, sp_prev_mines);
 
   bool connect_mode = false;
@@ -90,7 +92,7 @@ Durio::move() const {
 }
 
 MoveResult
-Durio::try_connect(const vector<vector<int>>& dist_mines) const {
+Durio::try_connect(const DistanceMatrix& dist_mines) const {
   uint32_t my_seed = (punter_id + history.size()) * 2654435769;
   mt19937 mt(my_seed);
 
@@ -144,8 +146,12 @@ Durio::try_connect(const vector<vector<int>>& dist_mines) const {
   int cur_v = random_element(group_vs[best_group_id], mt);
   cerr << "target component: " << group_vs[best_group_id] << endl;
 
-  // do random walk
+  // do random walk, leaving a quarter of the remaining time for the search below
+  const auto walk_deadline = chrono::steady_clock::now() + chrono::milliseconds(remaining_ms() * 3 / 4);
   for (int t = 0; t < max_turn; ++t) {
+    if ((t & 1023) == 0 && chrono::steady_clock::now() >= walk_deadline) {
+      break;
+    }
     next_cand.clear();
 
     // gather adjacent nodes (contract rivers that claimed by me)
@@ -194,7 +200,7 @@ Durio::try_connect(const vector<vector<int>>& dist_mines) const {
   }
 
   assert(src_mine != -1);
-  if (cmp_centrality(dist_mines[src_mine], dist_mines[to_mine]) > 0)
+  if (cmp_centrality(dist_mines.row_vector(src_mine), dist_mines.row_vector(to_mine)) > 0)
     swap(src_mine, to_mine);
 
   int best_src = -1, best_to = -1;
@@ -238,17 +244,18 @@ Durio::expand_tree() const {
   int64_t best_w = -1;
   int best_u = -1, best_v = -1;
 
-  for (int u = 0; u < g.num_vertices; ++u) {
+  for (int u = 0; u < g.num_vertices && !time_is_up(); ++u) {
     for (const auto& river : g.rivers[u]) {
       if (u < river.to && river.punter == -1) {
         claim(g, u, river.to, punter_id);
-        int64_t score = g.evaluate(num_punters, shortest_distances)[punter_id];
+        int64_t score = g.evaluate(num_punters, distance_table)[punter_id];
         claim(g, u, river.to, -1);
 
         if (best_w < score) {
           best_w = score;
           best_u = u;
           best_v = river.to;
+          update_best_move(make_tuple(best_u, best_v, info));
         }
       }
     }
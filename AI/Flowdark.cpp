@@ -1,4 +1,5 @@
 #include "Game.h"
+#include "Reliability.h"
 #include "UnionFind.h"
 #include <iostream>
 #include <queue>
@@ -17,14 +18,6 @@ namespace {
   };
 
 
-  // Copied from Galgalim.cpp
-  void claim(Graph& g, int src, int to, int p) {
-    auto& rs = g.rivers[src];
-    auto& rt = g.rivers[to];
-    std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->punter = p;
-    std::lower_bound(rt.begin(), rt.end(), Graph::River{src})->punter = p;
-  }
-
   int get_num_edges(const Graph &graph) {
     int num_edges = 0;
     for (int i = 0; i < graph.num_vertices; i++) {
@@ -77,7 +70,7 @@ namespace {
         assert(nrit != nullptr && nrit -> punter == -1);
         r.punter = punter;
         nrit->punter = punter;
-        const int next_point = graph.evaluate(game.get_num_punters(), game.get_shortest_distances())[punter];
+        const int next_point = graph.evaluate(game.get_num_punters(), game.get_distance_table())[punter];
         pair<int, int> current_data(next_point, graph.rivers[nv].size());
         if (current_data > best_data) {
           best_data = current_data;
@@ -93,47 +86,8 @@ namespace {
 }
 
 namespace flowlight {
-  void bfs(const Graph &graph, int source, vector<int> &distance) {
-    distance[source] = 0;
-    queue<int> que;
-    que.push(source);
-    while (!que.empty()) {
-      int v = que.front(); que.pop();
-      for (const auto &river: graph.rivers[v]) {
-        if (river.punter == -2) continue;
-        if (distance[river.to] == -1) {
-          que.push(river.to);
-          distance[river.to] = distance[v] + 1;
-        }
-      }
-    }
-  }
-
-  vector<int> select_near_mines(const Game& game, int mine) {
-    Graph graph = game.get_graph();
-    const double del_prob = 0.5;
-
-    vector<double> scores(graph.num_mines, 0.0);
-    for (int loop = 0; loop < 1000; ++loop) {
-      Graph g = graph;
-      for (int u = 0; u < g.num_vertices; ++u) {
-        for (const auto& river : g.rivers[u]) {
-          if (u < river.to && (double)rand() / RAND_MAX < del_prob) {
-            claim(g, u, river.to, -2);
-          }
-        }
-      }
-
-      vector<int> distance_after_random_remove(g.num_vertices, -1);
-      bfs(g, mine, distance_after_random_remove);
-      for (int m = 0; m < g.num_mines; ++m) {
-        const int d = distance_after_random_remove[m];
-        if (d > 0) {
-          scores[m] += 1.0 / d;
-        }
-      }
-    }
-
+  // |scores| is the row of |mine| in reliability::mine_closeness()
+  vector<int> select_near_mines(const Graph& graph, int mine, const vector<double>& scores) {
     vector<pair<double, int>> ms;
     for (int i = 0; i < graph.num_mines; ++i) {
       ms.emplace_back(-scores[i], i);
@@ -152,65 +106,31 @@ namespace flowlight {
   }
 
   pair<vector<int>, int> select_single_future(const Game *game, int turn_limit, double epsilon = 0.2) {
-    Graph g = game->get_graph();
-    const auto &shortest_distances = game->get_shortest_distances();
-
-    vector<vector<double> >  scores(g.num_mines, vector<double>(g.num_vertices, 0));
+    const Graph &g = game->get_graph();
+    const auto mine_scores = reliability::future_scores(
+      g, game->get_shortest_distances(), turn_limit, epsilon, 1000, game->get_punter_id());
 
+    const double del_prob = 0.5;
+    const auto closeness = reliability::mine_closeness(g, del_prob, 1000, game->get_punter_id());
     vector<vector<int> > neighbors(g.num_mines, vector<int>());
     for (int i = 0; i < g.num_mines; ++i) {
-      neighbors[i] = select_near_mines(*game, i);
+      neighbors[i] = select_near_mines(g, i, closeness[i]);
     }
 
-    for (int i = 0; i < 1000; i++) {
-      vector<tuple<int, int, int> > claimed;
-      for (int v = 0; v < g.num_vertices; v++) {
-        for (const auto &river: g.rivers[v]) {
-          if (v < river.to && (double) rand() / RAND_MAX < epsilon) {
-            claimed.push_back(make_tuple(v, river.to, river.punter));
-            claim(g, v, river.to, -2);
-          }
-        }
-      }
-
-      vector<vector<int> > distance_after_random_removes(g.num_mines, vector<int>(g.num_vertices, -1));
-      for (int m = 0; m < g.num_mines; m++) {
-        bfs(g, m, distance_after_random_removes[m]);
-      }
-
-      for (int m = 0; m < g.num_mines; m++) {
+    vector<vector<double> >  scores(g.num_mines, vector<double>(g.num_vertices, 0));
+    for (int m = 0; m < g.num_mines; m++) {
+      for (int nm : neighbors[m]) {
         for (int v = 0; v < g.num_vertices; v++) {
-          for (int nm : neighbors[m]) {
-            const int d1 = shortest_distances[nm][v];
-            const int d2 = distance_after_random_removes[nm][v];
-            if (d2 > 0 && d1 < turn_limit) {
-              scores[m][v] += (double) (d1 * d1 * d1) / (d2 * d2);
-            }
-          }
+          scores[m][v] += mine_scores[nm][v];
         }
       }
-
-      for (const auto &c: claimed) {
-        int src, dst, punter;
-        tie(src, dst, punter) = c;
-        claim(g, src, dst, punter);
-      }
     }
 
-    int best_source = 0;
-    int best_target = 0;
-    for (int m = 0; m < g.num_mines; m++) {
-      for (int v = g.num_mines; v < g.num_vertices; v++) {
-        if (scores[m][v] > scores[best_source][best_target]) {
-          best_source = m;
-          best_target = v;
-        }
-      }
-    }
-    return make_pair(neighbors[best_source], best_target);
+    const pair<int, int> best = reliability::best_future(scores, g.num_mines);
+    return make_pair(neighbors[best.first], best.second);
   }
 
-  void sort_future_mines(const vector<vector<int> > &dists, vector<int> &mines) {
+  void sort_future_mines(const DistanceMatrix &dists, vector<int> &mines) {
     sort(mines.begin(), mines.end());
     int best_cost = 1<<29;
     vector<int> best_order = mines;
@@ -1,4 +1,5 @@
 #include "FlowlightUtil.h"
+#include "Reliability.h"
 #include "UnionFind.h"
 #include <iostream>
 #include <queue>
@@ -16,14 +17,6 @@ namespace {
   };
 
   
-  // Copied from Galgalim.cpp
-  void claim(Graph& g, int src, int to, int p) {
-    auto& rs = g.rivers[src];
-    auto& rt = g.rivers[to];
-    std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->punter = p;
-    std::lower_bound(rt.begin(), rt.end(), Graph::River{src})->punter = p;
-  }
-  
   
   set<int> get_visited_sites(const Game &game, int punter) {
     set<int> vertices;
@@ -69,7 +62,7 @@ namespace {
         assert(nrit != nullptr && nrit -> punter == -1);
         r.punter = punter;
         nrit->punter = punter;
-        const int next_point = graph.evaluate(game.get_num_punters(), game.get_shortest_distances(), punter)[punter];
+        const int next_point = graph.evaluate(game.get_num_punters(), game.get_distance_table(), punter)[punter];
         pair<int, int> current_data(next_point, graph.rivers[nv].size());
         if (current_data > best_data) {
           best_data = current_data;
@@ -85,68 +78,11 @@ namespace {
 }
 
 namespace flowlight {
-  void bfs(const Graph &graph, int source, vector<int> &distance) {
-    distance[source] = 0;
-    queue<int> que;
-    que.push(source);
-    while (!que.empty()) {
-      int v = que.front(); que.pop();
-      for (const auto &river: graph.rivers[v]) {
-        if (river.punter == -2) continue;
-        if (distance[river.to] == -1) {
-          que.push(river.to);
-          distance[river.to] = distance[v] + 1;
-        }
-      }
-    }
-  }
-  
   pair<int, int> select_single_future(const Game *game, int turn_limit, double epsilon = 0.2) {
-    Graph g = game->get_graph();
-    const auto &shortest_distances = game->get_shortest_distances();
-    
-    vector<vector<double> >  scores(g.num_mines, vector<double>(g.num_vertices, 0));
-    for (int i = 0; i < 100; i++) {
-      vector<tuple<int, int, int> > claimed;
-      for (int v = 0; v < g.num_vertices; v++) {
-        for (const auto &river: g.rivers[v]) {
-          if (v < river.to && (double) rand() / RAND_MAX < epsilon) {
-            claimed.push_back(make_tuple(v, river.to, river.punter));
-            claim(g, v, river.to, -2);
-          }
-        }
-      }
-
-      for (int m = 0; m < g.num_mines; m++) {
-        vector<int> distance_after_random_remove(g.num_vertices, -1);
-        bfs(g, m, distance_after_random_remove);
-        for (int v = 0; v < g.num_vertices; v++) {
-          const int d1 = shortest_distances[m][v];
-          const int d2 = distance_after_random_remove[v];
-          if (d2 > 0 && d1 < turn_limit) {
-            scores[m][v] += (double) (d1 * d1 * d1) / (d2 * d2);
-          }
-        }
-      }
-          
-      for (const auto &c: claimed) {
-        int src, dst, punter;
-        tie(src, dst, punter) = c;
-        claim(g, src, dst, punter);
-      }
-    }
-
-    int best_source = 0;
-    int best_target = 0;
-    for (int m = 0; m < g.num_mines; m++) {
-      for (int v = g.num_mines; v < g.num_vertices; v++) {
-        if (scores[m][v] > scores[best_source][best_target]) {
-          best_source = m;
-          best_target = v;
-        }
-      }
-    }
-    return make_pair(best_source, best_target);
+    const Graph &g = game->get_graph();
+    const auto scores = reliability::future_scores(
+      g, game->get_shortest_distances(), turn_limit, epsilon, 100, game->get_punter_id());
+    return reliability::best_future(scores, g.num_mines);
   }
   
   static UnionFind get_current_union_find(const Game &game, const Graph &graph) {
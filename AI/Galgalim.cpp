@@ -57,7 +57,7 @@ protected:
 
 private:
   int64_t test_order(
-    const vector<vector<int>>& dists,
+    const DistanceMatrix& dists,
     const vector<vector<int>>& prevs,
     const vector<int>& mine_ord,
     int& mines_united, pair<int, int>& first_unite) const;
@@ -79,7 +79,8 @@ Galgalim::move() const {
   seed_seq seed = {(int)history.size(), punter_id};
   mt_engine.seed(seed);
 
-  vector<vector<int>> cur_dists, cur_prevs;
+  DistanceMatrix cur_dists;
+  vector<vector<int>> cur_prevs;
   calc_cur_dists(cur_dists, cur_prevs);
 
   vector<int> unite_order(graph.num_mines);
@@ -141,7 +142,7 @@ Galgalim::move() const {
 
 int64_t
 Galgalim::test_order(
-  const vector<vector<int>>& dists,
+  const DistanceMatrix& dists,
   const vector<vector<int>>& prevs,
   const vector<int>& mine_ord,
   int& mines_united, pair<int, int>& first_unite) const {
@@ -236,7 +237,7 @@ Galgalim::test_order(
     ++selected;
   }
 
-  return g.evaluate(num_punters, shortest_distances)[punter_id] * 1000 / first_sel / first_sel;
+  return g.evaluate(num_punters, distance_table)[punter_id] * 1000 / first_sel / first_sel;
 }
 
 void
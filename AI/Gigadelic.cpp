@@ -22,6 +22,8 @@
 #include <random>
 
 #include "Game.h"
+#include "Rng.h"
+#include "ThreadPool.h"
 #include "UnionFind.h"
 #include "json/json.h"
 
@@ -29,20 +31,6 @@ using namespace std;
 
 ///
 /// static functions/variables
-static mt19937 mt_engine;
-
-static int randint(int lo, int hi) {
-  std::uniform_int_distribution<int> dist(lo, hi);
-  return dist(mt_engine);
-}
-
-static void claim(Graph& g, int src, int to, int p) {
-  auto& rs = g.rivers[src];
-  auto& rt = g.rivers[to];
-  std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->punter = p;
-  std::lower_bound(rt.begin(), rt.end(), Graph::River{src})->punter = p;
-}
-
 static int owner(const Graph& g, int src, int to) {
   const auto& rs = g.rivers[src];
   return std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->punter;
@@ -97,7 +85,7 @@ protected:
   string name() const override;
 
 private:
-  void random_removal(vector<vector<int>>& conn_cnt) const; 
+  void random_removals(int count, uint64_t seed, vector<vector<int>>& conn_cnt) const;
 };
 
 string
@@ -111,24 +99,18 @@ Gigadelic::setup() const {
   const int M = graph.num_mines;
 
   vector<vector<int>> conn_cnt(M, vector<int>(M, 0));
-  for (int loop = 0; loop < LIM; loop += graph.num_edges) {
-    random_removal(conn_cnt);
-  }
+  random_removals((LIM + graph.num_edges - 1) / graph.num_edges, punter_id, conn_cnt);
 
   return Info(conn_cnt).to_json();
 }
 
 MoveResult
 Gigadelic::move() const {
-  seed_seq seed = {(int)history.size(), punter_id};
-  mt_engine.seed(seed);
-
   auto conn_cnt = Info::from_json(info).conn_cnt;
 
   const int LIM = 1000000;
-  for (int loop = 0; loop < LIM; loop += graph.num_edges) {
-    random_removal(conn_cnt);
-  }
+  random_removals((LIM + graph.num_edges - 1) / graph.num_edges,
+                  ((uint64_t)history.size() << 32) | punter_id, conn_cnt);
 
   UnionFind cur_uf(graph.num_vertices);
   for (int u = 0; u < graph.num_vertices; ++u) {
@@ -153,7 +135,8 @@ Gigadelic::move() const {
     return conn_cnt[a.first][a.second] > conn_cnt[b.first][b.second];
   });
 
-  vector<vector<int>> dists, prevs;
+  DistanceMatrix dists;
+  vector<vector<int>> prevs;
   calc_cur_dists(dists, prevs);
   for (const auto& mp : mine_pairs) {
     if (conn_cnt[mp.first][mp.second] == 0) {
@@ -177,13 +160,13 @@ Gigadelic::move() const {
 
   int64_t best_score = -INF;
   int best_u = -1, best_v = -1;
-  Graph g = graph;
-  for (int u = 0; u < g.num_vertices; ++u) {
-    for (const auto& river : g.rivers[u]) {
+  const int64_t current_score = graph.evaluate(num_punters, distance_table, punter_id)[punter_id];
+  const auto gains = graph.marginal_gains(punter_id, distance_table);
+  for (int u = 0; u < graph.num_vertices; ++u) {
+    for (size_t j = 0; j < graph.rivers[u].size(); ++j) {
+      const auto& river = graph.rivers[u][j];
       if (u < river.to && river.punter == -1) {
-        claim(g, u, river.to, punter_id);
-        int64_t score = g.evaluate(num_punters, shortest_distances)[punter_id];
-        claim(g, u, river.to, -1);
+        int64_t score = current_score + gains[u][j];
 
         if (best_score < score) {
           best_score = score;
@@ -197,34 +180,43 @@ Gigadelic::move() const {
   return make_tuple(best_u, best_v, Info(conn_cnt).to_json());
 }
 
+// Adds to conn_cnt[i][j] the number of |count| samples in which mines i and
+// j stay connected by free rivers when each one survives with probability
+// 1 / num_punters.  Sample k draws from Rng(seed, k), and the samples run on
+// the thread pool.
 void
-Gigadelic::random_removal(vector<vector<int>>& conn_cnt) const {
-  Graph g = graph;
-  for (int u = 0; u < g.num_vertices; ++u) {
-    for (const auto& river : g.rivers[u]) {
-      if (river.punter == punter_id) {
-        continue;
-      }
-      if (u < river.to && (river.punter >= 0 || randint(1, num_punters) != 1)) {
-        claim(g, u, river.to, 0);
+Gigadelic::random_removals(int count, uint64_t seed, vector<vector<int>>& conn_cnt) const {
+  const int M = graph.num_mines;
+  ThreadPool& pool = ThreadPool::shared();
+  vector<vector<int>> counts(pool.size(), vector<int>(M * M, 0));
+  pool.parallel_for(count, [&](int sample, int worker) {
+    Rng rng(seed, sample);
+
+    // claimed rivers, and ours, are never free
+    UnionFind uf(graph.num_vertices);
+    for (int u = 0; u < graph.num_vertices; ++u) {
+      for (const auto& river : graph.rivers[u]) {
+        if (u < river.to && river.punter < 0 && rng.below(num_punters) == 0) {
+          uf.unite(u, river.to);
+        }
       }
     }
-  }
 
-  UnionFind uf(g.num_vertices);
-  for (int u = 0; u < g.num_vertices; ++u) {
-    for (const auto& river : g.rivers[u]) {
-      if (river.punter == -1) {
-        uf.unite(u, river.to);
+    vector<int>& cnt = counts[worker];
+    for (int i = 0; i < M; ++i) {
+      for (int j = i + 1; j < M; ++j) {
+        if (uf.same(i, j)) {
+          ++cnt[i * M + j];
+        }
       }
     }
-  }
+  });
 
-  for (int i = 0; i < g.num_mines; ++i) {
-    for (int j = i + 1; j < g.num_mines; ++j) {
-      if (uf.same(i, j)) {
-        ++conn_cnt[i][j];
-        ++conn_cnt[j][i];
+  for (const auto& cnt : counts) {
+    for (int i = 0; i < M; ++i) {
+      for (int j = i + 1; j < M; ++j) {
+        conn_cnt[i][j] += cnt[i * M + j];
+        conn_cnt[j][i] += cnt[i * M + j];
       }
     }
   }
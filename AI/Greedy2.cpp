@@ -88,7 +88,8 @@ void Greedy2::calc_connected_mine(std::vector<int>* connected_mine) const {
 
 MoveResult Greedy2::move() const
 {
-  vector<vector<int>> dist, prev;
+  DistanceMatrix dist;
+  vector<vector<int>> prev;
   calc_cur_dists(dist, prev);
 
   vector<int> connected_mine;
@@ -132,33 +133,22 @@ MoveResult Greedy2::move() const
     }
   }
   
-  int current_max = -INF;
+  int64_t current_max = -INF;
   int to, from;
-  Graph mutable_graph = graph;
+  const int64_t current_score = graph.evaluate(num_punters, distance_table, punter_id)[punter_id];
+  const auto gains = graph.marginal_gains(punter_id, distance_table);
 
-  map<pair<int, int>, int> rev_edge;
-  for (size_t i = 0; i < mutable_graph.rivers.size(); ++i) {
-    for (size_t j = 0; j < mutable_graph.rivers[i].size(); ++j) {
-      rev_edge[make_pair(mutable_graph.rivers[i][j].to, i)] = j;
-    }
-  }
-
-  for (size_t i = 0; i < mutable_graph.rivers.size(); ++i) {
-    for (auto& r : mutable_graph.rivers[i]) {
+  for (int i = 0; i < graph.num_vertices; ++i) {
+    for (size_t j = 0; j < graph.rivers[i].size(); ++j) {
+      const auto& r = graph.rivers[i][j];
       if (current_max > -INF && connected_mine[i] == connected_mine[r.to]) 
       	continue;
-      if (r.punter != -1 || (int)i < r.to) continue;
-      r.punter = punter_id;
-      int ridx = rev_edge[make_pair(i, r.to)];
-      mutable_graph.rivers[r.to][ridx].punter = punter_id;
-      auto scores = mutable_graph.evaluate(num_punters, shortest_distances);
-      scores[punter_id];
-      r.punter = -1;
-      mutable_graph.rivers[r.to][ridx].punter = -1;
-      if (current_max < scores[punter_id]) {
+      if (r.punter != -1 || i < r.to) continue;
+      const int64_t score = current_score + gains[i][j];
+      if (current_max < score) {
 	to = i;
 	from = r.to;
-	current_max = scores[punter_id];
+	current_max = score;
       }
     }
   }
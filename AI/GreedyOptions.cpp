@@ -16,35 +16,6 @@
 
 using namespace std;
 
-static int owner(const Graph& g, int src, int to) {
-  const auto& rs = g.rivers[src];
-  return std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->punter;
-}
-
-static void claim(Graph& g, int src, int to, int p) {
-  auto& rs = g.rivers[src];
-  auto& rt = g.rivers[to];
-  if (owner(g, src, to) == -1) {
-    std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->punter = p;
-    std::lower_bound(rt.begin(), rt.end(), Graph::River{src})->punter = p;
-  } else {
-    std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->option = p;
-    std::lower_bound(rt.begin(), rt.end(), Graph::River{src})->option = p;    
-  }
-}
-
-static void unclaim(Graph& g, int src, int to, int p) {
-  auto& rs = g.rivers[src];
-  auto& rt = g.rivers[to];
-  if (owner(g, src, to) == p) {
-    std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->punter = -1;
-    std::lower_bound(rt.begin(), rt.end(), Graph::River{src})->punter = -1;    
-  } else {
-    std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->option = -1;
-    std::lower_bound(rt.begin(), rt.end(), Graph::River{src})->option = -1;    
-  }
-}
-
 class GreedyOptions : public Game {
   SetupSettings setup() const override;
   MoveResult move() const override;
@@ -63,19 +34,15 @@ MoveResult GreedyOptions::move() const {
   int64_t best_w = -INF;
   int best_u = -1, best_v = -1;
 
-  Graph g = graph;
-  for (int u = 0; u < g.num_vertices; ++u) {
-    for (const auto& river : g.rivers[u]) {
+  const bool buy_options = options_enabled && options_bought < graph.num_mines;
+  const int64_t current_score = graph.evaluate(num_punters, distance_table, punter_id)[punter_id];
+  const auto gains = graph.marginal_gains(punter_id, distance_table, buy_options);
+  for (int u = 0; u < graph.num_vertices; ++u) {
+    for (size_t j = 0; j < graph.rivers[u].size(); ++j) {
+      const auto& river = graph.rivers[u][j];
       if (u < river.to) {
-        bool trial = false;
-        trial |= river.punter == -1;
-        if (options_enabled && options_bought < g.num_mines) {
-          trial |= river.punter != punter_id && river.option == -1;
-        }
-        if (trial) {
-          claim(g, u, river.to, punter_id);
-          int64_t score = g.evaluate(num_punters, shortest_distances)[punter_id];
-          unclaim(g, u, river.to, punter_id);
+        if (gains[u][j] >= 0) {
+          int64_t score = current_score + gains[u][j];
           if (best_w < score) {
             best_w = score;
             best_u = u;
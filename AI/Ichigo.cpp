@@ -12,9 +12,9 @@
 #include <iomanip>
 #include <cassert>
 #include <numeric>
-#include <random>
 
 #include "../lib/Game.h"
+#include "../lib/Rng.h"
 
 #define trace(var) cerr<<">>> "<<#var<<" = "<<var<<endl;
 #define choose(vec) (vec[rand() % vec.size()])
@@ -58,12 +58,11 @@ SetupSettings Ichigo::setup() const {
 
 MoveResult Ichigo::move() const
 {
-    random_device dev;
-    mt19937 rand(dev());
+    Rng& rng = Rng::local();
 
     map<pair<int, int>, int> values;
 
-    const int LIMIT_MSEC = 400;
+    const int LIMIT_MSEC = min(400, remaining_ms());
 
     Graph roll = graph;
     for(
@@ -88,12 +87,12 @@ MoveResult Ichigo::move() const
                             continue;
                         }
 #endif
-                        r.punter = rand() % num_punters;
+                        r.punter = rng.below(num_punters);
                         replaced.emplace_back(&r);
                     }
                 }
 
-                auto scores = roll.evaluate(num_punters, shortest_distances);
+                auto scores = roll.evaluate(num_punters, distance_table);
                 // values[{i, r.to}] += scores[punter_id] > scores[(punter_id + 1) % num_punters] ? 1 : 0;
                 int wins = 0; for (auto&s: scores) if (scores[punter_id] >= s) wins++;
                 values[{i, r.to}] += wins;
@@ -12,9 +12,9 @@
 #include <iomanip>
 #include <cassert>
 #include <numeric>
-#include <random>
 
 #include "../lib/Game.h"
+#include "../lib/Rng.h"
 
 namespace Ichigo_weak {
 
@@ -61,12 +61,11 @@ SetupSettings Ichigo::setup() const {
 
 MoveResult Ichigo::move() const
 {
-    random_device dev;
-    mt19937 rand(dev());
+    Rng& rng = Rng::local();
 
     map<pair<int, int>, int> values;
 
-    const int LIMIT_MSEC = 850;
+    const int LIMIT_MSEC = min(850, remaining_ms());
 
     Graph roll = graph;
     for(
@@ -86,13 +85,13 @@ MoveResult Ichigo::move() const
                         if (painted.count({r.to, i})) {  // revere edge was painted
                             r.punter = painted[{r.to, i}];
                         } else {
-                            r.punter = rand() % num_punters;
+                            r.punter = rng.below(num_punters);
                         }
                         replaced.emplace_back(&r);
                     }
                 }
 
-                auto scores = roll.evaluate(num_punters, shortest_distances);
+                auto scores = roll.evaluate(num_punters, distance_table);
                 // values[{i, r.to}] += scores[punter_id] > scores[(punter_id + 1) % num_punters] ? 1 : 0;
                 int wins = 0; for (auto&s: scores) if (scores[punter_id] >= s) wins++;
                 values[{i, r.to}] += wins;
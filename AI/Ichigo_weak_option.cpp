@@ -12,9 +12,9 @@
 #include <iomanip>
 #include <cassert>
 #include <numeric>
-#include <random>
 
 #include "../lib/Game.h"
+#include "../lib/Rng.h"
 
 
 static int owner(const Graph& g, int src, int to) {
@@ -89,12 +89,11 @@ SetupSettings Ichigo::setup() const {
 
 MoveResult Ichigo::move() const
 {
-    random_device dev;
-    mt19937 rand(dev());
+    Rng& rng = Rng::local();
 
     map<pair<int, int>, int> values;
 
-    const int LIMIT_MSEC = 300;
+    const int LIMIT_MSEC = min(300, remaining_ms());
 
     vector<int> opt_used(num_punters, 0);
     for (int u = 0; u < graph.num_vertices; ++u) {
@@ -134,13 +133,13 @@ MoveResult Ichigo::move() const
                         if (painted.count({r.to, i})) {  // revere edge was painted
                             r.punter = painted[{r.to, i}];
                         } else {
-                            r.punter = rand() % num_punters;
+                            r.punter = rng.below(num_punters);
                         }
                         replaced.emplace_back(&r);
                     }
                 }
 
-                auto scores = roll.evaluate(num_punters, shortest_distances);
+                auto scores = roll.evaluate(num_punters, distance_table);
                 // values[{i, r.to}] += scores[punter_id] > scores[(punter_id + 1) % num_punters] ? 1 : 0;
                 int wins = 0; for (auto&s: scores) if (scores[punter_id] >= s) wins++;
                 values[{i, r.to}] += wins;
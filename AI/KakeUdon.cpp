@@ -118,7 +118,7 @@ pair<int,int> KakeUdonAI::decideFeature() const {
   if (num_mine_edges < 3 * num_punters) {
     return make_pair(-1,-1);
   }
-  auto dists =  graph.calc_shortest_distances();
+  const auto& dists = get_shortest_distances();
   auto num_of_turns = graph.num_edges / num_punters;
   auto limit_dist = (int) floor(num_of_turns * LIMIT_DISTANCE_THRESHOLD);
 
@@ -170,7 +170,7 @@ MoveResult KakeUdonAI::move() const {
     visited.insert(node.asInt());
   }
 
-  auto orig_dists =  graph.calc_shortest_distances();
+  const auto& orig_dists = get_shortest_distances();
   auto my_dists =  calc_my_shortest_distances();
 
 
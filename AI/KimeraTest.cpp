@@ -107,7 +107,7 @@ Genocide,
         int mn = 1 << 29;
         for (int i = 0; i < graph.num_mines; ++i) {
             for (int j = i + 1; j < graph.num_mines; ++j) {
-                mn = min<int>(mn, shortest_distances[i][j]);
+                mn = min<int>(mn, get_shortest_distances()[i][j]);
             }
         }
         f.push_back(mn);
@@ -127,7 +127,7 @@ Genocide,
         double sum = 0.0;
         for (int i = 0; i < graph.num_mines; ++i) {
             for (int j = i + 1; j < graph.num_mines; ++j) {
-                sum += shortest_distances[i][j];
+                sum += get_shortest_distances()[i][j];
             }
         }
         f.push_back(( (sum * 2 / graph.num_mines / (graph.num_mines + 1)) ));
@@ -90,7 +90,8 @@ void Greedy2::calc_connected_mine(std::vector<int>* connected_mine) const {
 
 MoveResult Greedy2::move() const
 {
-  vector<vector<int>> dist, prev;
+  DistanceMatrix dist;
+  vector<vector<int>> prev;
   calc_cur_dists(dist, prev);
 
   vector<int> connected_mine;
@@ -138,7 +139,7 @@ MoveResult Greedy2::move() const
   if (remaining_turns < 100) {
 	  auto g = *this;
 	  MCTS_Core core(&g);
-	  auto p = core.get_play(950);
+	  auto p = core.get_play(remaining_ms());
 	  return make_tuple(p.first, p.second, Json::Value());
   }
 
@@ -161,7 +162,7 @@ MoveResult Greedy2::move() const
       r.punter = punter_id;
       int ridx = rev_edge[make_pair(i, r.to)];
       mutable_graph.rivers[r.to][ridx].punter = punter_id;
-      auto scores = mutable_graph.evaluate(num_punters, shortest_distances);
+      auto scores = mutable_graph.evaluate(num_punters, distance_table);
       scores[punter_id];
       r.punter = -1;
       mutable_graph.rivers[r.to][ridx].punter = -1;
@@ -23,13 +23,10 @@ typedef pair<int, int> move_t;
 
 
 
-const int TIMELIMIT_MS_FOR_SETUP = 9500;
-const int TIMELIMIT_MS_FOR_MOVE = 950;
-
 SetupSettings MCTS_AI::setup() const {
 	MCTS_AI g = *this;
 	MCTS_Core core(&g);
-	vector<int> futures = core.get_futures(TIMELIMIT_MS_FOR_SETUP);
+	vector<int> futures = core.get_futures(remaining_ms());
 	for(auto p : futures) cerr << p << " "; cerr << endl;
 	return SetupSettings(Json::Value(), futures);
 //	return SetupSettings(Json::Value(), futures);
@@ -38,7 +35,7 @@ SetupSettings MCTS_AI::setup() const {
 MoveResult MCTS_AI::move() const {
   MCTS_AI g = *this;
   MCTS_Core core(&g);
-	auto p = core.get_play(TIMELIMIT_MS_FOR_MOVE);
+	auto p = core.get_play(remaining_ms());
 	return make_tuple(p.first, p.second, Json::Value());
 
 }
@@ -39,7 +39,7 @@ SetupSettings MCTS_GREEDY_AI::setup() const {
 MoveResult MCTS_GREEDY_AI::move() const {
   MCTS_GREEDY_AI g = *this;
 	MCTS_Core core(&g, 0.5);
-	int timelimit_ms = 950;
+	int timelimit_ms = remaining_ms();
 	auto p = core.get_play(timelimit_ms);
 	return make_tuple(p.first, p.second, Json::Value());
 }
@@ -28,7 +28,7 @@ SetupSettings MCTS_AI::setup() const {
 MoveResult MCTS_AI::move() const {
   MCTS_AI g = *this;
 	MCTS_Core core(&g);
-	int timelimit_ms = 200;
+	int timelimit_ms = min(200, remaining_ms());
 	auto p = core.get_play(timelimit_ms);
 	return make_tuple(p.first, p.second, Json::Value());
 }
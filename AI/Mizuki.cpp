@@ -105,7 +105,7 @@ MoveResult MizukiAI::move() const
           r.punter = punter_id;
           int ridx = lower_bound(graph.rivers[r.to].begin(), graph.rivers[r.to].end(), i) - graph.rivers[r.to].begin();
           mutable_graph.rivers[r.to][ridx].punter = punter_id;
-          auto score = mutable_graph.evaluate(num_punters, shortest_distances, punter_id)[punter_id];
+          auto score = mutable_graph.evaluate(num_punters, distance_table, punter_id)[punter_id];
           r.punter = -1;
           mutable_graph.rivers[r.to][ridx].punter = -1;
           
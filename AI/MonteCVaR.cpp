@@ -15,6 +15,7 @@
 #include <chrono>
 
 #include "../lib/Game.h"
+#include "../lib/Rng.h"
 
 class MonteGreedy : public Game {
 	SetupSettings setup() const override;
@@ -28,9 +29,6 @@ using namespace std;
 typedef pair<int, int> move_t;
 
 
-const int TIMELIMIT_MS_FOR_SETUP = 9500;
-const int TIMELIMIT_MS_FOR_MOVE = 950;
-
 SetupSettings MonteGreedy::setup() const {
 	vector<int> futures(this->graph.num_mines, -1);
 	return SetupSettings(Json::Value(), futures);
@@ -46,7 +44,10 @@ MoveResult MonteGreedy::move() const {
 			candidates.emplace_back(0, make_pair(i, r.to));
 		}
 	}
+	double best_sum = -1;
+	Rng& rng = Rng::local();
 	for(auto &p : candidates) {
+		if (time_is_up()) break;
 		move_t move = p.second;
 
 		const int LOOP_TIMES = 10000;
@@ -71,7 +72,7 @@ MoveResult MonteGreedy::move() const {
 						int &x = adjm[i][r.to];
 						if ((x >> 1) != t) {
 							/* randomly color */
-							x = (t<<1) | (rand() * 1.0 / RAND_MAX <= 1.0 / num_punters);
+							x = (t<<1) | (rng.below(num_punters) == 0);
 						}
 						if (!(x&1)) continue;
 					}
@@ -82,8 +83,8 @@ MoveResult MonteGreedy::move() const {
 			double score = 0.0;
 			for(int m = 0; m < this->graph.num_mines; m++) {
 				if (visited[m]) {
-					score += shortest_distances[m][move.first] * shortest_distances[m][move.first];
-					score += shortest_distances[m][move.second] * shortest_distances[m][move.second];
+					score += distance_table.square(m, move.first);
+					score += distance_table.square(m, move.second);
 				}
 			}
 			scores[t] = score;
@@ -98,6 +99,10 @@ MoveResult MonteGreedy::move() const {
 
 		p.first = sum;
 		cerr << move.first << " -> " << move.second << " : " << p.first << endl;
+		if (best_sum < sum) {
+			best_sum = sum;
+			update_best_move(make_tuple(move.first, move.second, Json::Value()));
+		}
 	}
 	cerr << "------" << endl;
 	sort(candidates.rbegin(), candidates.rend());
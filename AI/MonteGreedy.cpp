@@ -14,6 +14,7 @@
 #include <chrono>
 
 #include "../lib/Game.h"
+#include "../lib/Rng.h"
 
 class MonteGreedy : public Game {
 	SetupSettings setup() const override;
@@ -27,9 +28,6 @@ using namespace std;
 typedef pair<int, int> move_t;
 
 
-const int TIMELIMIT_MS_FOR_SETUP = 9500;
-const int TIMELIMIT_MS_FOR_MOVE = 950;
-
 SetupSettings MonteGreedy::setup() const {
 	vector<int> futures(this->graph.num_mines, -1);
 	return SetupSettings(Json::Value(), futures);
@@ -53,8 +51,6 @@ struct Choice {
 };
 
 MoveResult MonteGreedy::move() const {
-	auto start_time = chrono::system_clock::now();
-
 	vector<vector<int>> adjm(graph.num_vertices, vector<int>(graph.num_vertices, 0)); /* adjm[i][j] : time_t << 1 | built? */
 	priority_queue<Choice> candidates;
 	for(int i = 0; i < graph.num_vertices; i++) {
@@ -71,11 +67,11 @@ MoveResult MonteGreedy::move() const {
 	  */
 
 	double max_score = 1;
+	Rng& rng = Rng::local();
 	int n_simulated_total = 0;
 
 	while(true) {
-		auto elapsed_time = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now() - start_time).count();
-		if (elapsed_time >= TIMELIMIT_MS_FOR_MOVE) break;
+		if (time_is_up()) break;
 
 		n_simulated_total++;
 		Choice choice = candidates.top();
@@ -102,7 +98,7 @@ MoveResult MonteGreedy::move() const {
 					int &x = adjm[i][r.to];
 					if ((x >> 1) != n_simulated_total) {
 						/* randomly color */
-						x = (n_simulated_total<<1) | (rand() * 1.0 / RAND_MAX <= 1.0 / num_punters);
+						x = (n_simulated_total<<1) | (rng.below(num_punters) == 0);
 					}
 					if (!(x&1)) continue;
 				}
@@ -112,8 +108,8 @@ MoveResult MonteGreedy::move() const {
 		}
 		for(int m = 0; m < this->graph.num_mines; m++) {
 			if (visited[m]) {
-				score += shortest_distances[m][move.first] * shortest_distances[m][move.first];
-				score += shortest_distances[m][move.second] * shortest_distances[m][move.second];
+				score += distance_table.square(m, move.first);
+				score += distance_table.square(m, move.second);
 			}
 		}
 
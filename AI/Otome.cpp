@@ -21,19 +21,12 @@ using namespace std;
 
 using ll = long long;
 
-struct Data {
-  ll point;
-  int degree;
-};
-
-const int TIMELIMIT_MS_FOR_MOVE = 950;
 const int MCTS_EDGE_THRESHOLD = 200;
 
 class AI : public Game {
   SetupSettings setup() const override;
   MoveResult move() const override;
   std::string name() const override;
-  pair<int,int> getBestData(int pid, const Data& base_data, const vector<int> &in_vertices, Graph& myown_graph) const;
 };
 
 std::string AI::name() const {
@@ -45,65 +38,6 @@ SetupSettings AI::setup() const {
   return vertices;// it should be empty first.
 }
 
-bool shouldChange(Data* best_data, const Data& current_data) {
-  if (current_data.point > best_data->point) {
-    *best_data = current_data;
-    return true;
-  } else if(current_data.point == best_data->point) {
-    if (current_data.degree > best_data->degree) {
-      *best_data = current_data;
-      return true;
-    }
-  }
-  return false;
-}
-
-#define INF 1070000000LL
-
-pair<int,int> AI::getBestData(int pid, const Data& base_data, const vector<int> &in_vertices, Graph& myown_graph) const {
-  Data best_data = base_data;
-  int src = -1, to = -1;
-  for (int v = 0; v < (int) myown_graph.num_vertices; v++) {
-    for (auto& r :  myown_graph.rivers[v]) {
-      auto nv = r.to;
-      if (v > nv) {
-        continue;
-      }
-      if (r.punter != -1) {
-        continue;
-      }
-      if (v >= myown_graph.num_mines && nv >= myown_graph.num_mines && !in_vertices[v] && !in_vertices[nv]) {
-        continue;
-      }
-      if (in_vertices[v] && in_vertices[nv]) {
-        continue;
-      }
-      Graph::River* nrit = nullptr;
-      for (auto &nr : myown_graph.rivers[nv]) {
-        if (nr.to == v) {
-          nrit = &nr;
-          break;
-        }
-      }
-      assert(nrit != nullptr);
-      r.punter = pid;
-      nrit->punter = pid;
-      const auto& next_point = myown_graph.evaluate(num_punters, shortest_distances)[pid];
-      Data current_data;
-      current_data.point = next_point;
-      current_data.degree = myown_graph.rivers[nv].size();
-      if (shouldChange(&best_data, current_data)) {
-        src = v;
-        to = nv;
-      }
-      r.punter = -1;
-      nrit->punter = -1;
-    }
-  }
-  return make_pair(src, to);
-}
-
-
 MoveResult AI::move() const {
   int num_edges = 0;
   for (const auto& r : graph.rivers) {
@@ -114,26 +48,28 @@ MoveResult AI::move() const {
   if (num_edges - history.size() <= MCTS_EDGE_THRESHOLD) {
     AI g = *this;
     MCTS_Core core(&g, 0.5);
-    auto p = core.get_play(TIMELIMIT_MS_FOR_MOVE);
+    auto p = core.get_play(remaining_ms());
     return make_tuple(p.first, p.second, Json::Value());
   }
 
-  auto start_time = chrono::system_clock::now();
-  
   Json::Value vertices_ = info;
   std::vector<int> in_vertices(graph.num_vertices, 0);
   for (int i = 0, N = vertices_.size(); i < N; i++) {
     in_vertices[vertices_[i].asInt()] = 1;
   }
-  Graph myown_graph = graph;
-  const auto& points = myown_graph.evaluate(num_punters, shortest_distances);
-  Data base_data;
-  base_data.point = points[punter_id];
-  base_data.degree = INF;
+  const auto& points = graph.evaluate(num_punters, distance_table);
+  // rivers touching a mine or the vertices taken so far, but not both
+  // endpoints taken
+  const auto allowed = [&](int u, int v) {
+    if (u >= graph.num_mines && v >= graph.num_mines && !in_vertices[u] && !in_vertices[v]) {
+      return false;
+    }
+    return !(in_vertices[u] && in_vertices[v]);
+  };
+  const auto best = graph.best_gains(num_punters, distance_table, allowed);
 
   // First, try to maximize my score
-  auto src_to = getBestData(punter_id, base_data, in_vertices, myown_graph);
-  //cerr << src_to.first << " " << src_to.second << " maximize me" << endl;
+  pair<int,int> src_to(best[punter_id].src, best[punter_id].to);
   if (src_to.first == -1 && src_to.second == -1) {
     // Fail. That is, there is no edge to increase my score.
     // Then, try to decrease the final another's score.
@@ -146,17 +82,9 @@ MoveResult AI::move() const {
     }
     sort(enemys.begin(), enemys.end());
     reverse(enemys.begin(), enemys.end());
-    Data enemy_base_data;
     for (const auto&  e : enemys) {
-      enemy_base_data.point = e.first;
-      enemy_base_data.degree = INF;
-      const auto& enemy_src_to = getBestData(e.second, enemy_base_data, in_vertices, myown_graph);
-      if (enemy_src_to.first != -1 && enemy_src_to.second != -1) {
-        src_to = enemy_src_to;
-        break;
-      }
-      auto elapsed_time = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now() - start_time).count();
-      if (elapsed_time >= 900) {
+      if (best[e.second].src != -1) {
+        src_to = make_pair(best[e.second].src, best[e.second].to);
         break;
       }
     }
@@ -166,8 +94,8 @@ MoveResult AI::move() const {
   
   if (src == -1 && to == -1) {
     // In this case, I pick up any vertex.
-    for (int v = 0; v < (int) myown_graph.num_vertices; v++) {
-      for (const auto& r :  myown_graph.rivers[v]) {
+    for (int v = 0; v < (int) graph.num_vertices; v++) {
+      for (const auto& r :  graph.rivers[v]) {
         if (r.punter == -1) {
           src = v;
           to = r.to;
@@ -12,9 +12,9 @@
 #include <iomanip>
 #include <cassert>
 #include <numeric>
-#include <random>
 
 #include "../lib/Game.h"
+#include "../lib/Rng.h"
 
 #define trace(var) cerr<<">>> "<<#var<<" = "<<var<<endl;
 #define choose(vec) (vec[rand() % vec.size()])
@@ -61,8 +61,8 @@ SetupSettings Ichigo::setup() const {
         diag = 0;
         for (int i = 0; i < graph.num_mines; ++i) {
             for (int j = 0; j < graph.num_vertices; ++j) {
-                if (diag < shortest_distances[i][j]) {
-                    diag = shortest_distances[i][j];
+                if (diag < get_shortest_distances()[i][j]) {
+                    diag = get_shortest_distances()[i][j];
                 }
             }
         }
@@ -99,8 +99,7 @@ tuple<bool, int> f(const Graph& graph, int s, int punter_id) {
 
 MoveResult Ichigo::move() const
 {
-    random_device dev;
-    mt19937 rand(dev());
+    Rng& rng = Rng::local();
 
     // info
     Json::Value next_info = info;
@@ -108,7 +107,7 @@ MoveResult Ichigo::move() const
     int diag = info["diag"].asInt(); trace(diag);
     next_info["turn"] = turn + num_punters;
 
-    const int LIMIT_MSEC = 960;
+    const int LIMIT_MSEC = min(960, remaining_ms());
 
     map<pair<int, int>, int> values;
 
@@ -154,14 +153,14 @@ MoveResult Ichigo::move() const
                             r.punter = painted[{r.to, i}];
                         }
 #endif
-                        r.punter = rand() % num_punters;
+                        r.punter = rng.below(num_punters);
                         replaced.emplace_back(&r);
                     }
                 }
 
 skip_future_move: ;
 
-                auto scores = roll.evaluate(num_punters, shortest_distances);
+                auto scores = roll.evaluate(num_punters, distance_table);
 
                 // mine-edge bonus
                 if ((int)i < graph.num_mines or r.to < graph.num_mines) {
@@ -171,7 +170,7 @@ skip_future_move: ;
                 // imcomplete information
                 for (int p = 0; p < num_punters; ++p) {
                     if (p == punter_id) continue;
-                    if (rand() % 4 == 0) {
+                    if (rng.below(4) == 0) {
                         scores[p] *= 2;
                     } else {
                         scores[p] = scores[p] * 5 / 3;
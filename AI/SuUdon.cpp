@@ -48,8 +48,8 @@ MoveResult SuUdonAI::move() const {
     visited.insert(node.asInt());
   }
 
-  auto orig_dists =  graph.calc_shortest_distances();
-  std::vector<std::vector<int>> my_dists, my_prevs;
+  DistanceMatrix my_dists;
+  std::vector<std::vector<int>> my_prevs;
   calc_cur_dists(my_dists, my_prevs);
 
   const int all_turns = graph.num_edges;
@@ -121,7 +121,7 @@ MoveResult SuUdonAI::move() const {
           int64_t pt = 0;
           for (int i = 0; i < graph.num_mines; ++i) {
             if (visited.find(i) != visited.end()) {
-              pt += orig_dists[i][river.to] * orig_dists[i][river.to];
+              pt += distance_table.square(i, river.to);
             }
           }
           if (best_pt < pt) {
@@ -21,22 +21,10 @@ using namespace std;
 
 using ll = long long;
 
-struct Data {
-  ll point;
-  int degree;
-};
-
-struct MyMove {
-  int src;
-  int to;
-  ll score;
-};
-
 class AI : public Game {
   SetupSettings setup() const override;
   MoveResult move() const override;
   std::string name() const override;
-  MyMove getBestData(int pid, const Data& base_data, const vector<int> &in_vertices, Graph& myown_graph) const;
 };
 
 std::string AI::name() const {
@@ -48,68 +36,6 @@ SetupSettings AI::setup() const {
   return vertices;// it should be empty first.
 }
 
-bool shouldChange(Data* best_data, const Data& current_data) {
-  if (current_data.point > best_data->point) {
-    *best_data = current_data;
-    return true;
-  } else if(current_data.point == best_data->point) {
-    if (current_data.degree > best_data->degree) {
-      *best_data = current_data;
-      return true;
-    }
-  }
-  return false;
-}
-
-#define INF 1070000000LL
-
-MyMove AI::getBestData(int pid, const Data& base_data, const vector<int> &in_vertices, Graph& myown_graph) const {
-  Data best_data = base_data;
-  MyMove next_move;
-  next_move.src = 0; next_move.to = 0; next_move.score = 0;
-  
-  for (int v = 0; v < (int) myown_graph.num_vertices; v++) {
-    for (auto& r :  myown_graph.rivers[v]) {
-      auto nv = r.to;
-      if (v > nv) {
-        continue;
-      }
-      if (r.punter != -1) {
-        continue;
-      }
-      if (v >= myown_graph.num_mines && nv >= myown_graph.num_mines && !in_vertices[v] && !in_vertices[nv]) {
-        continue;
-      }
-      if (in_vertices[v] && in_vertices[nv]) {
-        continue;
-      }
-      Graph::River* nrit = nullptr;
-      for (auto &nr : myown_graph.rivers[nv]) {
-        if (nr.to == v) {
-          nrit = &nr;
-          break;
-        }
-      }
-      assert(nrit != nullptr);
-      r.punter = pid;
-      nrit->punter = pid;
-      const auto& next_point = myown_graph.evaluate(num_punters, shortest_distances)[pid];
-      Data current_data;
-      current_data.point = next_point;
-      current_data.degree = myown_graph.rivers[nv].size();
-      if (shouldChange(&best_data, current_data)) {
-        next_move.src = v;
-        next_move.to = nv;
-        next_move.score = next_point;
-      }
-      r.punter = -1;
-      nrit->punter = -1;
-    }
-  }
-  return next_move;
-}
-
-
 MoveResult AI::move() const {
   Json::Value vertices_ = info;
   // if there is an edge connecting to mine,
@@ -123,17 +49,19 @@ MoveResult AI::move() const {
     in_vertices[vertices_[i].asInt()] = 1;
   }
   
-  Graph myown_graph = graph;
-  const auto& scores = myown_graph.evaluate(num_punters, shortest_distances);
-  
+  // rivers touching a mine or the vertices taken so far, but not both
+  // endpoints taken
+  const auto allowed = [&](int u, int v) {
+    if (u >= graph.num_mines && v >= graph.num_mines && !in_vertices[u] && !in_vertices[v]) {
+      return false;
+    }
+    return !(in_vertices[u] && in_vertices[v]);
+  };
+  const auto next_move = graph.best_gains(num_punters, distance_table, allowed);
+
   std::vector<ll> increase_scores(num_punters);
-  std::vector<MyMove> next_move(num_punters);
   for (int i = 0; i < num_punters; i++) {
-    Data base_data;
-    base_data.point = scores[i];
-    base_data.degree = INF;
-    next_move[i]  = getBestData(i, base_data, in_vertices, myown_graph);
-    increase_scores[i] = next_move[i].score - scores[i];
+    increase_scores[i] = next_move[i].gain;
   }
   assert(num_punters > punter_id);
   
@@ -84,7 +84,7 @@ pair<int,int> AI::getBestData(int pid, const Data& base_data, const vector<int>
       assert(nrit != nullptr);
       r.punter = pid;
       nrit->punter = pid;
-      const auto& next_point = myown_graph.evaluate(num_punters, shortest_distances)[pid];
+      const auto& next_point = myown_graph.evaluate(num_punters, distance_table)[pid];
       Data current_data;
       current_data.point = next_point;
       current_data.degree = myown_graph.rivers[nv].size();
@@ -118,7 +118,7 @@ tuple<int,int, Json::Value> AI::move() const {
 
   for (int div : div_nums) {
     if (all_turns / div == cur_turn) {
-      auto point = graph.evaluate(num_punters, shortest_distances);
+      auto point = graph.evaluate(num_punters, distance_table);
       std::cerr << "Single Play: punter_id = " << punter_id << std::endl;
       std::cerr << "All = " << all_turns << " cur_turn=" << cur_turn << std::endl;
       std::cerr << "div=" << div << ", point = " << point[punter_id] << std::endl;
@@ -136,7 +136,7 @@ tuple<int,int, Json::Value> AI::move() const {
     in_vertices[vertices_[i].asInt()] = 1;
   }
   Graph myown_graph = graph;
-  const auto& points = myown_graph.evaluate(num_punters, shortest_distances);
+  const auto& points = myown_graph.evaluate(num_punters, distance_table);
   Data base_data;
   base_data.point = points[punter_id];
   base_data.degree = INF;
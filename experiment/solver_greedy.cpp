@@ -20,9 +20,8 @@ int main(int argc, char** argv) {
   reader.parse(ifs, json);
 
   Graph graph;
-  std::vector<int> reverse_id_map;
-  std::map<int, int> id_map;
-  std::tie(graph, reverse_id_map, id_map) = Graph::from_json_setup(json);
+  IdMap id_map;
+  std::tie(graph, id_map) = Graph::from_json_setup(json);
 
   Json::Value LOG;
 
@@ -63,8 +62,8 @@ int main(int argc, char** argv) {
     int os, ot;
     move["scores"].append(cur_pt);
     move["claim"]["punter"] = 0;
-    move["claim"]["source"] = os = reverse_id_map[best_s];
-    move["claim"]["target"] = ot = reverse_id_map[best_t];
+    move["claim"]["source"] = os = id_map.original(best_s);
+    move["claim"]["target"] = ot = id_map.original(best_t);
     LOG["moves"].append(move);
 
     for (Json::Value& river : json["rivers"]) {
@@ -143,9 +143,8 @@ int main(int argc, char** argv) {
   reader.parse(ifs, json);
 
   Graph graph;
-  std::vector<int> reverse_id_map;
-  std::map<int, int> id_map;
-  std::tie(graph, reverse_id_map, id_map) = Graph::from_json_setup(json);
+  IdMap id_map;
+  std::tie(graph, id_map) = Graph::from_json_setup(json);
 
   Json::Value LOG;
 
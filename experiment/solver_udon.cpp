@@ -17,13 +17,6 @@ void claim(Graph& g, int src, int to, int p) {
 std::vector<std::vector<int>> g_dists;
 int g_num_edges;
 
-double eval_greedy(Graph& g, int src, int to) {
-  claim(g, src, to, 0);
-  int64_t pt = g.evaluate(1, g_dists)[0];
-  claim(g, src, to, -1);
-  return pt;
-}
-
 double eval_connect(Graph& g, int src, int to, std::set<int>& visited) {
   int pt = 10000000;
   for(int i = 0; i < g.num_mines; ++i) {
@@ -45,14 +38,13 @@ int main(int argc, char** argv) {
   reader.parse(ifs, json);
 
   Graph graph;
-  std::vector<int> reverse_id_map;
-  std::map<int, int> id_map;
-  std::tie(graph, reverse_id_map, id_map) = Graph::from_json_setup(json);
+  IdMap id_map;
+  std::tie(graph, id_map) = Graph::from_json_setup(json);
 
   Json::Value LOG;
 
   g_dists = graph.calc_shortest_distances();
-  auto dists = g_dists;
+  const DistanceTable dists(g_dists);
 
   int num_edges = 0;
   for (int i = 0; i < graph.num_vertices; ++i) {
@@ -79,10 +71,12 @@ int main(int argc, char** argv) {
     int best_s = -1, best_t = -1;
     if (greedy_mode) {
       double best_pt = -1;
+      const auto gains = graph.marginal_gains(0, dists);
       for (int u = 0; u < graph.num_vertices; ++u) {
-        for (const auto& river : graph.rivers[u]) {
+        for (size_t j = 0; j < graph.rivers[u].size(); ++j) {
+          const auto& river = graph.rivers[u][j];
           if (u < river.to && river.punter == -1) {
-            double pt = eval_greedy(graph, u, river.to);
+            double pt = cur_pt + gains[u][j];
             if (best_pt < pt) {
               best_pt = pt;
               best_s = u;
@@ -117,8 +111,8 @@ int main(int argc, char** argv) {
     int os, ot;
     move["scores"].append(cur_pt);
     move["claim"]["punter"] = 0;
-    move["claim"]["source"] = os = reverse_id_map[best_s];
-    move["claim"]["target"] = ot = reverse_id_map[best_t];
+    move["claim"]["source"] = os = id_map.original(best_s);
+    move["claim"]["target"] = ot = id_map.original(best_t);
     LOG["moves"].append(move);
 
     for (Json::Value& river : json["rivers"]) {
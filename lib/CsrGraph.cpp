@@ -0,0 +1,239 @@
+#include "CsrGraph.h"
+#include "TurnStats.h"
+
+#include <algorithm>
+#include <cassert>
+
+/*
+ *  Construction and conversion
+ */
+
+CsrGraph
+CsrGraph::from_graph(const Graph& graph) {
+  CsrGraph g;
+  g.num_mines = graph.num_mines;
+  g.num_vertices = graph.num_vertices;
+
+  g.offsets.resize(graph.num_vertices + 1);
+  int num_halves = 0;
+  for (int u = 0; u < graph.num_vertices; ++u) {
+    g.offsets[u] = num_halves;
+    num_halves += graph.rivers[u].size();
+  }
+  g.offsets[graph.num_vertices] = num_halves;
+  g.num_edges = num_halves / 2;
+
+  g.neighbors.resize(num_halves);
+  g.edge_ids.assign(num_halves, -1);
+  g.twins.assign(num_halves, -1);
+  g.ownership = OwnershipTable(g.num_edges);
+  g.edge_half.resize(g.num_edges);
+
+  // the k-th river u -> v is paired with the k-th river v -> u; rivers are
+  // sorted by head, so parallel rivers are contiguous
+  int next_edge = 0;
+  for (int u = 0; u < graph.num_vertices; ++u) {
+    const auto& rs = graph.rivers[u];
+    for (int i = 0; i < (int)rs.size(); ++i) {
+      const int h = g.offsets[u] + i;
+      const int v = rs[i].to;
+      g.neighbors[h] = v;
+      if (v < u) {
+        continue;
+      }
+      const int k = i - (std::lower_bound(rs.begin(), rs.end(), Graph::River(v)) - rs.begin());
+      int twin;
+      if (v == u) {
+        // a loop appears twice in its own list
+        if (k % 2) {
+          continue;
+        }
+        twin = h + 1;
+      } else {
+        const auto& vs = graph.rivers[v];
+        twin = g.offsets[v] + (std::lower_bound(vs.begin(), vs.end(), Graph::River(u)) - vs.begin()) + k;
+      }
+      assert(twin < g.offsets[v + 1]);
+      const int e = next_edge++;
+      g.edge_ids[h] = g.edge_ids[twin] = e;
+      g.twins[h] = twin;
+      g.twins[twin] = h;
+      g.edge_half[e] = h;
+      g.ownership.set_punter(e, rs[i].punter);
+      g.ownership.set_option(e, rs[i].option);
+    }
+  }
+  assert(next_edge == g.num_edges);
+  return g;
+}
+
+void
+CsrGraph::apply_to(Graph& graph, const OwnershipTable& own) const {
+  for (int u = 0; u < num_vertices; ++u) {
+    auto& rs = graph.rivers[u];
+    for (int h = offsets[u]; h < offsets[u + 1]; ++h) {
+      auto& river = rs[h - offsets[u]];
+      river.punter = own.punter(edge_ids[h]);
+      river.option = own.option(edge_ids[h]);
+    }
+  }
+}
+
+void
+CsrGraph::sync_from(const Graph& graph) {
+  for (int e = 0; e < num_edges; ++e) {
+    const int h = edge_half[e];
+    const int u = neighbors[twins[h]];
+    const auto& river = graph.rivers[u][h - offsets[u]];
+    ownership.set_punter(e, river.punter);
+    ownership.set_option(e, river.option);
+  }
+}
+
+int
+CsrGraph::half_edge(int u, int v) const {
+  const auto first = neighbors.begin() + offsets[u];
+  const auto last = neighbors.begin() + offsets[u + 1];
+  const auto it = std::lower_bound(first, last, v);
+  return it != last && *it == v ? it - neighbors.begin() : -1;
+}
+
+
+/*
+ *  Distances and scores
+ */
+
+std::vector<std::vector<int>>
+CsrGraph::calc_shortest_distances() const {
+  turn_stats::ScopedTimer timer(turn_stats::SHORTEST_DISTANCES);
+  turn_stats::count(turn_stats::BFS, num_mines);
+  std::vector<int> que(num_vertices);
+
+  std::vector<std::vector<int>> distances;
+  for (int mine = 0; mine < num_mines; ++mine) {
+    std::vector<int> dist(num_vertices, 1<<29);
+    int qb = 0, qe = 0;
+    que[qe++] = mine;
+    dist[mine] = 0;
+    while (qb < qe) {
+      const int u = que[qb++];
+      const int du = dist[u] + 1;
+      for (int h = offsets[u]; h < offsets[u + 1]; ++h) {
+        const int v = neighbors[h];
+        if (dist[v] > du) {
+          dist[v] = du;
+          que[qe++] = v;
+        }
+      }
+    }
+    distances.push_back(std::move(dist));
+  }
+
+  return distances;
+}
+
+std::vector<int64_t>
+CsrGraph::evaluate(
+  int num_punters,
+  const std::vector<std::vector<int>>& distances, int calc_punter) const {
+  int64_t dummy;
+  return evaluate(num_punters, distances, -1, {}, dummy, calc_punter);
+}
+
+std::vector<int64_t>
+CsrGraph::evaluate(
+  int num_punters,
+  const std::vector<std::vector<int>>& distances,
+  int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+  int calc_punter) const {
+  return evaluate(ownership, num_punters, distances, my_punter_id, futures, future_score, calc_punter);
+}
+
+std::vector<int64_t>
+CsrGraph::evaluate(
+  const OwnershipTable& own, int num_punters,
+  const std::vector<std::vector<int>>& distances,
+  int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+  int calc_punter) const {
+  return evaluate_with(own, num_punters, distances, my_punter_id, futures, future_score, calc_punter);
+}
+
+std::vector<int64_t>
+CsrGraph::evaluate(
+  const OwnershipTable& own, int num_punters, const DistanceTable& table,
+  int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+  int calc_punter) const {
+  return evaluate_with(own, num_punters, table, my_punter_id, futures, future_score, calc_punter);
+}
+
+template<class Distances>
+std::vector<int64_t>
+CsrGraph::evaluate_with(
+  const OwnershipTable& own, int num_punters, const Distances& distances,
+  int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+  int calc_punter) const {
+  turn_stats::count(turn_stats::EVALUATE);
+  const int* punters = own.punters();
+  const int* options = own.options();
+  std::vector<int64_t> scores(num_punters, 0LL);
+  std::vector<int> que(num_vertices);
+  std::vector<char> visited(DistanceTable::padded_size(num_vertices), 0);
+
+  future_score = 0;
+
+  int punter_start = 0;
+  int punter_end = num_punters;
+  if (calc_punter != -1) {
+    punter_start = calc_punter;
+    punter_end = calc_punter + 1;
+  }
+
+  int num_bfs = 0;
+  std::vector<char> computed_mine(num_mines);
+  for (int punter = punter_start; punter < punter_end; ++punter) {
+    std::fill(computed_mine.begin(), computed_mine.end(), 0);
+    for (int mine = 0; mine < num_mines; ++mine) {
+      if (computed_mine[mine]) continue;
+      ++num_bfs;
+
+      int qb = 0, qe = 0;
+      que[qe++] = mine;
+      visited[mine] = 1;
+      while (qb < qe) {
+        const int u = que[qb++];
+        for (int h = offsets[u]; h < offsets[u + 1]; ++h) {
+          const int e = edge_ids[h];
+          if (punters[e] != punter && options[e] != punter) continue;
+          const int v = neighbors[h];
+          if (!visited[v]) {
+            que[qe++] = v;
+            visited[v] = 1;
+          }
+        }
+      }
+
+      const int reach_cnt = qe;
+
+      // every mine reached by this BFS shares the same component
+      for (int tmine = mine; tmine < num_mines; ++tmine) {
+        if (computed_mine[tmine] || !visited[tmine]) continue;
+
+        computed_mine[tmine] = true;
+        if (punter == my_punter_id && futures[tmine] >= 0) {
+          const int64_t dis = mine_distance(distances, tmine, futures[tmine]);
+          const bool future_ok = visited[futures[tmine]] == 1;
+          future_score += (future_ok ? +1 : -1) * dis * dis * dis;
+        }
+
+        scores[punter] += sum_squares(distances, tmine, que.data(), reach_cnt, visited.data());
+      }
+
+      for (int i = 0; i < reach_cnt; ++i) {
+        visited[que[i]] = 0;
+      }
+    }
+  }
+  turn_stats::count(turn_stats::BFS, num_bfs);
+
+  return scores;
+}
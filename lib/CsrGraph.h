@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include "Game.h"
+#include "DistanceTable.h"
+
+/*
+ *  Compressed sparse row view of a Graph.
+ *
+ *  Every undirected river is stored as two half-edges.  The neighbours of
+ *  vertex u are neighbors[offsets[u] .. offsets[u + 1]) (sorted, as in
+ *  Graph::rivers); each half-edge knows its undirected edge id and the
+ *  index of its twin (v -> u).  Ownership lives in one slot per edge
+ *  (see OwnershipTable), so a claim is a single store instead of two
+ *  find_river() calls.
+ *
+ *  from_graph() / apply_to() convert from and to Graph, so that an AI can
+ *  move its hot loops onto the CSR layout one at a time.
+ */
+
+/*
+ *  The mutable part of the graph: punter and option holder of every
+ *  undirected edge (-1 if none), in one flat buffer so that copying,
+ *  snapshotting and restoring the ownership is a single memcpy.
+ */
+
+class OwnershipTable {
+  int num_edges;
+  std::vector<int> slots;  // [0, num_edges): punter, [num_edges, 2 * num_edges): option
+public:
+  OwnershipTable() : num_edges(0) {}
+  explicit OwnershipTable(int num_edges) : num_edges(num_edges), slots(2 * num_edges, -1) {}
+
+  int size() const { return num_edges; }
+  int punter(int e) const { return slots[e]; }
+  int option(int e) const { return slots[num_edges + e]; }
+  void set_punter(int e, int punter) { slots[e] = punter; }
+  void set_option(int e, int punter) { slots[num_edges + e] = punter; }
+
+  const int* punters() const { return slots.data(); }
+  const int* options() const { return slots.data() + num_edges; }
+
+  // |snapshot| must come from a table of the same graph
+  void restore(const OwnershipTable& snapshot) {
+    memcpy(slots.data(), snapshot.slots.data(), slots.size() * sizeof(int));
+  }
+};
+
+struct CsrGraph {
+  int num_mines = 0;
+  int num_vertices = 0;
+  int num_edges = 0;
+
+  std::vector<int> offsets;     // [num_vertices + 1]
+  std::vector<int> neighbors;   // [2 * num_edges], half-edge -> head
+  std::vector<int> edge_ids;    // [2 * num_edges], half-edge -> edge
+  std::vector<int> twins;       // [2 * num_edges], half-edge -> reverse half-edge
+
+  OwnershipTable ownership;
+
+  static CsrGraph from_graph(const Graph& graph);
+  // copies |own| (by default the ownership) back to |graph|, which must
+  // have the same topology
+  void apply_to(Graph& graph) const { apply_to(graph, ownership); }
+  void apply_to(Graph& graph, const OwnershipTable& own) const;
+  // refreshes the ownership from |graph|
+  void sync_from(const Graph& graph);
+
+  int begin(int u) const { return offsets[u]; }
+  int end(int u) const { return offsets[u + 1]; }
+  int degree(int u) const { return offsets[u + 1] - offsets[u]; }
+
+  // half-edge from |u| to |v|, -1 if they are not adjacent
+  int half_edge(int u, int v) const;
+  // undirected edge between |u| and |v|, -1 if they are not adjacent
+  int edge(int u, int v) const {
+    const int h = half_edge(u, v);
+    return h < 0 ? -1 : edge_ids[h];
+  }
+  // the endpoints of edge |e|, u < v
+  int edge_source(int e) const { return neighbors[twins[edge_half[e]]]; }
+  int edge_target(int e) const { return neighbors[edge_half[e]]; }
+
+  int owner(int u, int v) const { return ownership.punter(edge(u, v)); }
+  void claim(int e, int punter) { ownership.set_punter(e, punter); }
+  void buy_option(int e, int punter) { ownership.set_option(e, punter); }
+
+  // same results as the Graph versions
+  std::vector<std::vector<int>> calc_shortest_distances() const;
+  std::vector<int64_t> evaluate(
+    int num_punters,
+    const std::vector<std::vector<int>>& distances, int calc_punter = -1) const;
+  std::vector<int64_t> evaluate(
+    int num_punters,
+    const std::vector<std::vector<int>>& distances,
+    int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+    int calc_punter = -1) const;
+
+  // the same, scoring the ownership |own| instead of this->ownership
+  std::vector<int64_t> evaluate(
+    const OwnershipTable& own, int num_punters,
+    const std::vector<std::vector<int>>& distances,
+    int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+    int calc_punter = -1) const;
+  std::vector<int64_t> evaluate(
+    const OwnershipTable& own, int num_punters, const DistanceTable& table,
+    int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+    int calc_punter = -1) const;
+
+private:
+  std::vector<int> edge_half;   // [num_edges], edge -> half-edge u -> v with u < v
+
+  template<class Distances>
+  std::vector<int64_t> evaluate_with(
+    const OwnershipTable& own, int num_punters, const Distances& distances,
+    int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+    int calc_punter) const;
+};
@@ -0,0 +1,290 @@
+#include "CurrentDistances.h"
+#include "Game.h"
+#include "TurnStats.h"
+
+#include <algorithm>
+#include <functional>
+
+const int64_t CurrentDistances::UNREACHABLE;
+
+namespace {
+
+// a key counts the paid rivers in its upper half and all rivers in the lower
+const int64_t FREE_RIVER = (1LL << 32) + 1;
+const int64_t OWN_RIVER = 1;
+
+// more rivers than this changed since the last update: search again
+const int REBUILD_RATIO = 8;
+
+const char TOUCHED = 1;
+const char PREV_QUEUED = 2;
+
+}
+
+int64_t
+CurrentDistances::weight(int owner) const {
+  if (owner == -1) {
+    return FREE_RIVER;
+  }
+  return owner == punter ? OWN_RIVER : -1;
+}
+
+void
+CurrentDistances::build(const Graph& graph, int punter, const std::vector<int>& sources) {
+  this->punter = punter;
+  this->sources = sources;
+  num_vertices = graph.num_vertices;
+
+  offsets.assign(num_vertices + 1, 0);
+  heads.clear();
+  tails.clear();
+  owners.clear();
+  for (int u = 0; u < num_vertices; ++u) {
+    for (const Graph::River& river : graph.rivers[u]) {
+      heads.push_back(river.to);
+      tails.push_back(u);
+      owners.push_back(river.punter);
+    }
+    offsets[u + 1] = heads.size();
+  }
+
+  weights.resize(owners.size());
+  for (size_t h = 0; h < owners.size(); ++h) {
+    weights[h] = weight(owners[h]);
+  }
+
+  keys.assign(sources.size() * num_vertices, UNREACHABLE);
+  prevs.assign(sources.size() * num_vertices, -1);
+  mark.assign(num_vertices, 0);
+  for (int s = 0; s < (int)sources.size(); ++s) {
+    search(s);
+  }
+}
+
+void
+CurrentDistances::search(int s) {
+  turn_stats::count(turn_stats::BFS);
+  int64_t* key = &keys[(size_t)s * num_vertices];
+  int* prev = &prevs[(size_t)s * num_vertices];
+  std::fill(key, key + num_vertices, UNREACHABLE);
+  std::fill(prev, prev + num_vertices, -1);
+
+  // Dijkstra with two weights: the vertices reached over own rivers and
+  // over free ones are each pushed in key order, so the smaller of the two
+  // fronts is always the next vertex to settle
+  light.clear();
+  heavy.clear();
+  key[sources[s]] = 0;
+  light.emplace_back(0, sources[s]);
+  size_t li = 0, hi = 0;
+  while (li < light.size() || hi < heavy.size()) {
+    const bool take_light = hi == heavy.size() || (li < light.size() && light[li] <= heavy[hi]);
+    const std::pair<int64_t, int> top = take_light ? light[li++] : heavy[hi++];
+    const int v = top.second;
+    if (top.first != key[v]) {
+      continue;
+    }
+    // every neighbor a path can come from is settled by now
+    find_prev(s, v);
+    for (int h = offsets[v]; h < offsets[v + 1]; ++h) {
+      const int64_t w = weights[h];
+      if (w < 0) {
+        continue;
+      }
+      const int t = heads[h];
+      if (top.first + w < key[t]) {
+        key[t] = top.first + w;
+        (w == OWN_RIVER ? light : heavy).emplace_back(key[t], t);
+      }
+    }
+  }
+}
+
+void
+CurrentDistances::find_prev(int s, int v) {
+  const int64_t* key = &keys[(size_t)s * num_vertices];
+  int& prev = prevs[(size_t)s * num_vertices + v];
+  prev = -1;
+  if (key[v] == UNREACHABLE || v == sources[s]) {
+    return;
+  }
+  for (int h = offsets[v]; h < offsets[v + 1]; ++h) {
+    const int64_t w = weights[h];
+    const int u = heads[h];
+    if (w >= 0 && key[u] != UNREACHABLE && key[u] + w == key[v]) {
+      prev = u;
+      return;
+    }
+  }
+}
+
+bool
+CurrentDistances::update(const Graph& graph) {
+  if (graph.num_vertices != num_vertices || (int)heads.size() != 2 * graph.num_edges) {
+    return false;
+  }
+  for (int u = 0; u < num_vertices; ++u) {
+    const auto& rs = graph.rivers[u];
+    if ((int)rs.size() != offsets[u + 1] - offsets[u]) {
+      return false;
+    }
+    for (size_t j = 0; j < rs.size(); ++j) {
+      if (rs[j].to != heads[offsets[u] + j]) {
+        return false;
+      }
+    }
+  }
+
+  changed.clear();
+  changed_owners.clear();
+  for (int u = 0; u < num_vertices; ++u) {
+    const auto& rs = graph.rivers[u];
+    for (size_t j = 0; j < rs.size(); ++j) {
+      const int h = offsets[u] + j;
+      if (rs[j].punter != owners[h]) {
+        changed.push_back(h);
+        changed_owners.push_back(owners[h]);
+        owners[h] = rs[j].punter;
+        weights[h] = weight(owners[h]);
+      }
+    }
+  }
+  if (changed.empty()) {
+    return true;
+  }
+
+  if ((int)changed.size() * REBUILD_RATIO > (int)heads.size()) {
+    for (int s = 0; s < (int)sources.size(); ++s) {
+      search(s);
+    }
+  } else {
+    for (int s = 0; s < (int)sources.size(); ++s) {
+      repair(s);
+    }
+  }
+  return true;
+}
+
+void
+CurrentDistances::repair(int s) {
+  int64_t* key = &keys[(size_t)s * num_vertices];
+  const int* prev = &prevs[(size_t)s * num_vertices];
+  const auto later = std::greater<std::pair<int64_t, int>>();
+  touched.clear();
+  heap.clear();
+
+  // a vertex whose path crosses a river that got dearer keeps no valid
+  // key: drop the subtrees below such rivers.  Every other vertex still has
+  // its old path, which costs at most its old key
+  for (size_t i = 0; i < changed.size(); ++i) {
+    const int h = changed[i];
+    const int64_t before = weight(changed_owners[i]), after = weights[h];
+    const int b = heads[h];
+    if (before >= 0 && (after < 0 || after > before) && prev[b] == tails[h] && !mark[b]) {
+      mark[b] = TOUCHED;
+      touched.push_back(b);
+    }
+  }
+  for (size_t i = 0; i < touched.size(); ++i) {
+    const int x = touched[i];
+    for (int h = offsets[x]; h < offsets[x + 1]; ++h) {
+      const int y = heads[h];
+      if (prev[y] == x && !mark[y]) {
+        mark[y] = TOUCHED;
+        touched.push_back(y);
+      }
+    }
+  }
+  for (const int x : touched) {
+    key[x] = UNREACHABLE;
+  }
+
+  // the dropped vertices start from their remaining neighbors, and rivers
+  // that got cheaper from their ends; the search then settles the rest
+  auto relax = [&](int x, int64_t k) {
+    if (k < key[x]) {
+      key[x] = k;
+      if (!mark[x]) {
+        mark[x] = TOUCHED;
+        touched.push_back(x);
+      }
+      heap.emplace_back(k, x);
+      std::push_heap(heap.begin(), heap.end(), later);
+    }
+  };
+  const size_t dropped = touched.size();
+  for (size_t i = 0; i < dropped; ++i) {
+    const int x = touched[i];
+    for (int h = offsets[x]; h < offsets[x + 1]; ++h) {
+      const int64_t w = weights[h];
+      const int y = heads[h];
+      if (w >= 0 && key[y] != UNREACHABLE) {
+        relax(x, key[y] + w);
+      }
+    }
+  }
+  for (size_t i = 0; i < changed.size(); ++i) {
+    const int h = changed[i];
+    const int64_t before = weight(changed_owners[i]), after = weights[h];
+    const int a = tails[h];
+    if (after >= 0 && (before < 0 || after < before) && key[a] != UNREACHABLE) {
+      relax(heads[h], key[a] + after);
+    }
+  }
+  while (!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), later);
+    const std::pair<int64_t, int> top = heap.back();
+    heap.pop_back();
+    const int v = top.second;
+    if (top.first != key[v]) {
+      continue;
+    }
+    for (int h = offsets[v]; h < offsets[v + 1]; ++h) {
+      const int64_t w = weights[h];
+      if (w >= 0) {
+        relax(heads[h], top.first + w);
+      }
+    }
+  }
+
+  // prev(v) depends on the keys around v and the owners of its rivers
+  stale_prevs.clear();
+  auto queue_prev = [&](int v) {
+    if (!(mark[v] & PREV_QUEUED)) {
+      mark[v] |= PREV_QUEUED;
+      stale_prevs.push_back(v);
+    }
+  };
+  for (const int x : touched) {
+    queue_prev(x);
+    for (int h = offsets[x]; h < offsets[x + 1]; ++h) {
+      queue_prev(heads[h]);
+    }
+  }
+  for (const int h : changed) {
+    queue_prev(tails[h]);
+  }
+  for (const int v : stale_prevs) {
+    find_prev(s, v);
+    mark[v] = 0;
+  }
+  for (const int x : touched) {
+    mark[x] = 0;
+  }
+}
+
+void
+CurrentDistances::sync(const Graph& graph, int punter, const std::vector<int>& sources) {
+  if (punter != this->punter || sources != this->sources || !update(graph)) {
+    build(graph, punter, sources);
+  }
+}
+
+void
+CurrentDistances::copy_row(int s, std::vector<int>& dist, std::vector<int>& prev, int inf) const {
+  dist.resize(num_vertices);
+  for (int v = 0; v < num_vertices; ++v) {
+    dist[v] = distance(s, v, inf);
+  }
+  prev.assign(prevs.begin() + (size_t)s * num_vertices, prevs.begin() + (size_t)(s + 1) * num_vertices);
+}
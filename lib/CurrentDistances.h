@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+
+struct Graph;
+
+/*
+ *  Distances from a set of sources through the rivers a punter can still
+ *  use, kept up to date as rivers are claimed.
+ *
+ *  A river of the punter costs 0, a free river 1, and a river of another
+ *  punter cannot be used.  Among the cheapest paths to v the structure
+ *  takes those with the fewest rivers, and prev(s, v) is the first
+ *  neighbor of v (in river order) that such a path can come from, so the
+ *  result depends only on the graph and not on how it was computed.
+ *
+ *  update() compares the owners of the rivers with the last build / update
+ *  and repairs only the vertices whose paths change: the subtrees hanging
+ *  from rivers that got more expensive are invalidated and searched again
+ *  from their surroundings, and cheaper rivers are propagated from their
+ *  ends.  It gives exactly what build() gives on the same graph.
+ */
+
+class CurrentDistances {
+  int punter = -1;
+  int num_vertices = 0;
+  std::vector<int> sources;
+
+  // the rivers of u are heads[offsets[u] .. offsets[u + 1]), with the owner
+  // each had at the last build / update and what crossing it adds to a key
+  // (-1 if it cannot be crossed); tails[h] is u
+  std::vector<int> offsets, heads, tails, owners;
+  std::vector<int64_t> weights;
+
+  // per source s at [s * num_vertices + v]: (distance << 32) + rivers
+  std::vector<int64_t> keys;
+  std::vector<int> prevs;
+
+  // scratch of search() / update()
+  std::vector<std::pair<int64_t, int>> light, heavy, heap;
+  std::vector<int> changed, changed_owners, touched, stale_prevs;
+  std::vector<char> mark;
+
+  // the weight of a river of |owner|
+  int64_t weight(int owner) const;
+  void search(int s);
+  void repair(int s);
+  void find_prev(int s, int v);
+public:
+  static const int64_t UNREACHABLE = INT64_MAX;
+
+  // from scratch for |punter| on |graph|
+  void build(const Graph& graph, int punter, const std::vector<int>& sources);
+  // to |graph|, which must have the same rivers as the last build; false
+  // (and nothing done) when it has not
+  bool update(const Graph& graph);
+  // update(), or build() when the graph, the punter or the sources differ
+  void sync(const Graph& graph, int punter, const std::vector<int>& sources);
+
+  bool empty() const { return sources.empty(); }
+  // |inf| when v cannot be reached from sources[s]
+  int distance(int s, int v, int inf) const {
+    const int64_t key = keys[(size_t)s * num_vertices + v];
+    return key == UNREACHABLE ? inf : key >> 32;
+  }
+  int prev(int s, int v) const { return prevs[(size_t)s * num_vertices + v]; }
+  // the distances of sources[s] as a vector of num_vertices entries
+  void copy_row(int s, std::vector<int>& dist, std::vector<int>& prev, int inf) const;
+};
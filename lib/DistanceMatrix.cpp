@@ -0,0 +1,124 @@
+#include "DistanceMatrix.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+const int DistanceMatrix::UNREACHABLE;
+
+namespace {
+
+int
+bytes_for(int max_distance) {
+  if (max_distance < UINT8_MAX) {
+    return 1;
+  }
+  if (max_distance < UINT16_MAX) {
+    return 2;
+  }
+  return 4;
+}
+
+}
+
+DistanceMatrix::DistanceMatrix(int rows, int cols, int max_distance, int unreachable)
+  : num_rows(rows), num_cols(cols), entry_bytes(bytes_for(max_distance)),
+    unreachable_value(unreachable) {
+  const size_t n = (size_t)rows * cols;
+  switch (entry_bytes) {
+  case 1:
+    narrow.assign(n, UINT8_MAX);
+    break;
+  case 2:
+    wide.assign(n, UINT16_MAX);
+    break;
+  default:
+    full.assign(n, unreachable);
+    break;
+  }
+}
+
+DistanceMatrix::DistanceMatrix(const std::vector<std::vector<int>>& distances, int unreachable)
+  : unreachable_value(unreachable) {
+  int max_distance = 0;
+  for (const auto& row : distances) {
+    for (const int d : row) {
+      if (d < unreachable) {
+        max_distance = std::max(max_distance, d);
+      }
+    }
+  }
+  *this = DistanceMatrix(distances.size(), distances.empty() ? 0 : distances[0].size(),
+                         max_distance, unreachable);
+  for (int row = 0; row < num_rows; ++row) {
+    set_row(row, distances[row].data());
+  }
+}
+
+void
+DistanceMatrix::set(int row, int col, int d) {
+  const size_t i = index(row, col);
+  const bool finite = d < unreachable_value;
+  switch (entry_bytes) {
+  case 1:
+    assert(!finite || d < UINT8_MAX);
+    narrow[i] = finite ? d : UINT8_MAX;
+    break;
+  case 2:
+    assert(!finite || d < UINT16_MAX);
+    wide[i] = finite ? d : UINT16_MAX;
+    break;
+  default:
+    full[i] = finite ? d : unreachable_value;
+    break;
+  }
+}
+
+void
+DistanceMatrix::set_row(int row, const int* distances) {
+  for (int col = 0; col < num_cols; ++col) {
+    set(row, col, distances[col]);
+  }
+}
+
+void
+DistanceMatrix::compact() {
+  int max_distance = 0;
+  for (int row = 0; row < num_rows; ++row) {
+    for (int col = 0; col < num_cols; ++col) {
+      const int d = get(row, col);
+      if (d != unreachable_value) {
+        max_distance = std::max(max_distance, d);
+      }
+    }
+  }
+  if (bytes_for(max_distance) == entry_bytes) {
+    return;
+  }
+  DistanceMatrix res(num_rows, num_cols, max_distance, unreachable_value);
+  for (int row = 0; row < num_rows; ++row) {
+    for (int col = 0; col < num_cols; ++col) {
+      res.set(row, col, get(row, col));
+    }
+  }
+  *this = std::move(res);
+}
+
+std::vector<int>
+DistanceMatrix::row_vector(int row) const {
+  std::vector<int> res(num_cols);
+  for (int col = 0; col < num_cols; ++col) {
+    res[col] = get(row, col);
+  }
+  return res;
+}
+
+std::vector<std::vector<int>>
+DistanceMatrix::to_vectors() const {
+  std::vector<std::vector<int>> res;
+  res.reserve(num_rows);
+  for (int row = 0; row < num_rows; ++row) {
+    res.push_back(row_vector(row));
+  }
+  return res;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ *  Compact distance matrices.
+ *
+ *  Distances from a few sources (mines, usually) to every vertex, stored
+ *  row-major in one buffer of 8-bit entries when every finite distance is
+ *  below 255, 16-bit entries when it is below 65535, and plain ints
+ *  otherwise.  The largest value of the entry type marks an unreachable
+ *  vertex; reads give unreachable() for it, which is chosen by the owner so
+ *  that code written against the old vector<vector<int>> tables (1 << 29,
+ *  or Game::INF) keeps its comparisons.
+ *
+ *  m[row][col] reads like the nested vectors did; writes go through set().
+ */
+
+class DistanceMatrix {
+  int num_rows = 0;
+  int num_cols = 0;
+  int entry_bytes = 1;
+  int unreachable_value = UNREACHABLE;
+  std::vector<uint8_t> narrow;   // entry_bytes == 1
+  std::vector<uint16_t> wide;    // entry_bytes == 2
+  std::vector<int> full;         // entry_bytes == 4
+
+  size_t index(int row, int col) const { return (size_t)row * num_cols + col; }
+public:
+  // what unreachable() is unless the owner says otherwise; the sentinel of
+  // Graph::calc_shortest_distances()
+  static const int UNREACHABLE = 1 << 29;
+
+  class Row {
+    const DistanceMatrix* matrix;
+    int row;
+  public:
+    Row(const DistanceMatrix* matrix, int row) : matrix(matrix), row(row) {}
+    int operator[](int col) const { return matrix->get(row, col); }
+    int size() const { return matrix->cols(); }
+  };
+
+  DistanceMatrix() {}
+  // |rows| x |cols| entries, all unreachable, wide enough for distances up
+  // to |max_distance|
+  DistanceMatrix(int rows, int cols, int max_distance, int unreachable = UNREACHABLE);
+  // |distances|, where entries >= |unreachable| are unreachable, in the
+  // narrowest entries that hold them
+  explicit DistanceMatrix(const std::vector<std::vector<int>>& distances, int unreachable = UNREACHABLE);
+
+  int rows() const { return num_rows; }
+  int cols() const { return num_cols; }
+  bool empty() const { return num_rows == 0; }
+  int unreachable() const { return unreachable_value; }
+  // bytes per entry: 1, 2 or 4
+  int width() const { return entry_bytes; }
+  size_t memory_bytes() const { return (size_t)num_rows * num_cols * entry_bytes; }
+
+  int get(int row, int col) const {
+    const size_t i = index(row, col);
+    switch (entry_bytes) {
+    case 1:
+      return narrow[i] == UINT8_MAX ? unreachable_value : narrow[i];
+    case 2:
+      return wide[i] == UINT16_MAX ? unreachable_value : wide[i];
+    default:
+      return full[i];
+    }
+  }
+  bool reachable(int row, int col) const { return get(row, col) != unreachable_value; }
+  Row operator[](int row) const { return Row(this, row); }
+
+  // |d| >= unreachable() marks (row, col) unreachable; finite distances must
+  // fit the width chosen at construction
+  void set(int row, int col, int d);
+  // copies |distances|[0, cols()) into |row|
+  void set_row(int row, const int* distances);
+  // re-encodes the entries in the narrowest width that holds them, for
+  // owners that had to size the matrix before knowing the distances
+  void compact();
+
+  // |row| as a vector, unreachable entries as unreachable()
+  std::vector<int> row_vector(int row) const;
+  // every row; the inverse of the second constructor
+  std::vector<std::vector<int>> to_vectors() const;
+};
@@ -0,0 +1,47 @@
+#include "DistanceTable.h"
+
+DistanceTable::DistanceTable(const std::vector<std::vector<int>>& dists)
+  : num_mines(dists.size()),
+    num_vertices(dists.empty() ? 0 : dists[0].size()),
+    stride(padded_size(num_vertices)),
+    distances(dists),
+    squares((size_t)num_mines * stride, 0) {
+  for (int mine = 0; mine < num_mines; ++mine) {
+    for (int v = 0; v < num_vertices; ++v) {
+      const int d = dists[mine][v];
+      if (d < DistanceMatrix::UNREACHABLE) {
+        squares[(size_t)mine * stride + v] = (int64_t)d * d;
+      }
+    }
+  }
+}
+
+int64_t
+DistanceTable::sum(int mine, const int* vs, int count) const {
+  const int64_t* sq = row(mine);
+  // independent accumulators hide the latency of the gathers
+  int64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    s0 += sq[vs[i]];
+    s1 += sq[vs[i + 1]];
+    s2 += sq[vs[i + 2]];
+    s3 += sq[vs[i + 3]];
+  }
+  for (; i < count; ++i) {
+    s0 += sq[vs[i]];
+  }
+  return s0 + s1 + s2 + s3;
+}
+
+int64_t
+DistanceTable::masked_sum(int mine, const char* mask) const {
+  const int64_t* sq = static_cast<const int64_t*>(__builtin_assume_aligned(row(mine), 64));
+  // branch-free over whole rows of ROW_ALIGN entries, so that the compiler
+  // turns it into packed and / add
+  int64_t sum = 0;
+  for (int v = 0; v < stride; ++v) {
+    sum += sq[v] & -(int64_t)mask[v];
+  }
+  return sum;
+}
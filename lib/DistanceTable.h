@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "DistanceMatrix.h"
+
+/*
+ *  Contiguous mine distance tables.
+ *
+ *  Graph::calc_shortest_distances() gives one std::vector per mine; the
+ *  scorers then read dist(mine, v) through two indirections and square it
+ *  for every reached vertex.  DistanceTable keeps the squares mine-major in
+ *  a flat buffer whose rows are padded to a multiple of 8 entries and
+ *  start on a 64-byte boundary, and offers the summing kernels the scorers
+ *  need.  Unreachable vertices have square 0.  The distances themselves
+ *  are kept once, in the compact DistanceMatrix the table owns.
+ */
+
+// std::allocator with |Align|-byte aligned blocks
+template<class T, size_t Align>
+struct AlignedAllocator {
+  using value_type = T;
+  template<class U> struct rebind { using other = AlignedAllocator<U, Align>; };
+
+  AlignedAllocator() {}
+  template<class U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+  T* allocate(size_t n) {
+    void* p = nullptr;
+    if (posix_memalign(&p, Align, n * sizeof(T) + (n == 0)) != 0) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T*>(p);
+  }
+  void deallocate(T* p, size_t) { free(p); }
+
+  template<class U> bool operator==(const AlignedAllocator<U, Align>&) const { return true; }
+  template<class U> bool operator!=(const AlignedAllocator<U, Align>&) const { return false; }
+};
+
+class DistanceTable {
+  int num_mines = 0;
+  int num_vertices = 0;
+  int stride = 0;  // num_vertices rounded up to a multiple of ROW_ALIGN
+  DistanceMatrix distances;
+  std::vector<int64_t, AlignedAllocator<int64_t, 64>> squares;
+public:
+  static const int ROW_ALIGN = 8;
+  // size of a row, and of the masks passed to masked_sum(), for |n| vertices
+  static int padded_size(int n) { return (n + ROW_ALIGN - 1) / ROW_ALIGN * ROW_ALIGN; }
+
+  DistanceTable() {}
+  // |distances| as returned by Graph::calc_shortest_distances
+  explicit DistanceTable(const std::vector<std::vector<int>>& distances);
+
+  int mines() const { return num_mines; }
+  int vertices() const { return num_vertices; }
+  bool empty() const { return num_mines == 0; }
+
+  int distance(int mine, int v) const { return distances.get(mine, v); }
+  const DistanceMatrix& matrix() const { return distances; }
+  int64_t square(int mine, int v) const { return squares[(size_t)mine * stride + v]; }
+  // padded_size(vertices()) squares of |mine|, 64-byte aligned
+  const int64_t* row(int mine) const { return squares.data() + (size_t)mine * stride; }
+
+  // sum of dist(mine, v)^2 over vertices[0, count)
+  int64_t sum(int mine, const int* vertices, int count) const;
+  // sum of dist(mine, v)^2 over the v with mask[v] != 0; |mask| holds 0 / 1
+  // and has padded_size(vertices()) entries
+  int64_t masked_sum(int mine, const char* mask) const;
+  // sum over the vertex set given both as a list and as a mask, using
+  // whichever kernel touches less memory
+  int64_t sum(int mine, const int* vertices, int count, const char* mask) const {
+    return count * DENSE_RATIO >= stride ? masked_sum(mine, mask) : sum(mine, vertices, count);
+  }
+
+private:
+  // masked_sum() streams the whole row, sum() gathers; streaming wins once
+  // the set covers about a quarter of the vertices
+  static const int DENSE_RATIO = 4;
+};
+
+// the same queries on plain distance vectors, so that the scorers can be
+// written once for both
+inline int
+mine_distance(const std::vector<std::vector<int>>& distances, int mine, int v) {
+  return distances[mine][v];
+}
+
+inline int
+mine_distance(const DistanceTable& table, int mine, int v) {
+  return table.distance(mine, v);
+}
+
+inline int64_t
+sum_squares(const std::vector<std::vector<int>>& distances, int mine,
+            const int* vertices, int count, const char*) {
+  const std::vector<int>& dist = distances[mine];
+  int64_t sum = 0;
+  for (int i = 0; i < count; ++i) {
+    const int64_t d = dist[vertices[i]];
+    sum += d * d;
+  }
+  return sum;
+}
+
+inline int64_t
+sum_squares(const DistanceTable& table, int mine,
+            const int* vertices, int count, const char* mask) {
+  return table.sum(mine, vertices, count, mask);
+}
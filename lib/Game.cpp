@@ -1,4 +1,11 @@
 #include "Game.h"
+#include "IncrementalScorer.h"
+#include "StateCodec.h"
+#include "MapCache.h"
+#include "Zygote.h"
+#include "TurnStats.h"
+#include "Watchdog.h"
+#include "ThreadPool.h"
 
 #include "json/json.h"
 #include <iostream>
@@ -10,6 +17,12 @@
 #include <cassert>
 #include <memory>
 #include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <climits>
+#include <functional>
+#include <mutex>
+#include <unistd.h>
 
 #ifdef HAVE_CPU_PROFILER
 // $ apt install libgoogle-perftools-dev
@@ -17,7 +30,6 @@
 // $ ../bin/MCTS # execute binary
 // $ google-pprof --svg ../bin/MCTS prof.out > prof.svg
 #include <gperftools/profiler.h>
-#include <unistd.h>
 
 #endif
 
@@ -40,7 +52,7 @@ static const char* MOVE = "move";
 static const char* MOVES = "moves";
 static const char* CLAIM = "claim";
 static const char* PASS = "pass";
-static const char* STOP = "stop";
+// static const char* STOP = "stop";
 static const char* ME = "me";
 // static const char* YOU = "you";
 static const char* SETTINGS = "settings";
@@ -63,8 +75,84 @@ static const char* SPLURGES_ENABLED = "splurges_enabled";
 static const char* SPLURGE_LENGTH = "splurge_length";
 static const char* OPTIONS_ENABLED = "options_enabled";
 static const char* OPTIONS_BOUGHT = "options_bought";
+static const char* STATE_BLOB = "blob";
+static const char* SEARCH = "search";
+
+// vertex + river visits below which calc_shortest_distances() stays on the
+// calling thread
+static const int64_t PARALLEL_BFS_WORK = 1 << 17;
 
 namespace {
+  bool peek_map_hash(const std::string& message, uint64_t& hash);
+
+  /*
+   * Turn deadline.  It is shared by every Game object of the process,
+   * since AIs copy themselves or import() into helper AIs inside move().
+   */
+  typedef std::chrono::steady_clock Clock;
+
+  const int DEFAULT_MOVE_BUDGET_MS = 1000;
+  const int DEFAULT_SETUP_BUDGET_MS = 10000;
+  const int DEFAULT_RESERVE_MS = 50;
+
+  int env_ms(const char* name, int default_ms) {
+    const char* value = getenv(name);
+    return value ? atoi(value) : default_ms;
+  }
+
+  Clock::time_point turn_start = Clock::now();
+  Clock::time_point turn_deadline;
+  bool deadline_set = false;
+
+  // the reply sent when move() overruns, see Game::update_best_move
+  Watchdog watchdog;
+  Game* watched_game = nullptr;
+  int reply_fd = 1;
+  std::mutex best_move_mutex;
+  // the move of the last update_best_move(), resolved by the thread that
+  // registered it (see Game::resolve_move); guarded by best_move_mutex
+  struct {
+    const char* kind;
+    std::vector<int> route;
+    int splurge_length;
+    int options_bought;
+    Json::Value info;  // null: the info of the previous turn
+  } best_move;
+  struct {
+    // what the reply needs of the game, taken before move() by
+    // Game::snapshot_fallback()
+    int punter_id;
+    bool persistent;
+    Json::Value prev_info;
+    bool binary;
+    std::string state_head, state_body;  // binary
+    Json::Value json_state;              // JSON, without the turn counters
+    // written by the watchdog when it fires, read after disarm()
+    int splurge_length;
+    int options_bought;
+    Json::Value info;
+    Clock::time_point sent;
+  } fallback_state;
+
+  // the move member of a reply
+  void write_move(protocol::Writer& out, const char* kind, int punter, const std::vector<int>& route) {
+    out.key(kind).begin_object();
+    out.key(PUNTER).integer(punter);
+    if (kind == SPLURGE) {
+      out.key(ROUTE).begin_array();
+      for (const int v : route) {
+        out.integer(v);
+      }
+      out.end_array();
+    } else if (kind != PASS) {
+      out.key(SOURCE).integer(route[0]);
+      out.key(TARGET).integer(route[1]);
+    }
+    out.end_object();
+  }
+  // persistent mode: the last turn ended with the fallback
+  bool overran = false;
+
 #ifdef HAVE_CPU_PROFILER
   char prof_name[1000];
   char mktemp_name[1000];
@@ -104,29 +192,20 @@ namespace {
 
 namespace json_helper {
 Json::Value read_json() {
-  int length = 0;
-  while (true) {
-    int c = std::cin.get();
-    if (c == ':') {
-      break;
-    }
-    length = length * 10 + (c - '0');
-  }
-
-  std::unique_ptr<char[]> json_buf(new char[length + 1]);
-  std::cin.read(json_buf.get(), length);
-
+  const char* payload;
+  size_t length;
   Json::Value json;
-  Json::Reader reader;
-  reader.parse(json_buf.get(), json);
-
+  if (protocol::stdin_reader().next(payload, length)) {
+    Json::Reader reader;
+    reader.parse(payload, payload + length, json);
+  }
   return json;
 }
 
 void write_json(const Json::Value& json) {
-  Json::FastWriter writer;
-  std::string json_str = writer.write(json);
-  std::cout << json_str.size() << ":" << json_str << std::flush;
+  protocol::Writer writer;
+  writer.json(json);
+  writer.flush(1);
 }
 }
 
@@ -181,43 +260,55 @@ Graph::from_json(const Json::Value& json) {
   return g;
 }
 
-std::tuple<Graph, std::vector<int>, std::map<int, int>>
+std::tuple<Graph, IdMap>
 Graph::from_json_setup(const Json::Value& json) {
-  Graph g;
-  std::map<int, int> id_map;
-  std::vector<int> reverse_id_map;
-
-  g.num_mines = json[MINES].size();
-  g.num_vertices = json[SITES].size();
-  g.num_edges = json[RIVERS].size();
-
-  int cur_id = 0;
+  std::vector<int> sites, mines;
+  std::vector<protocol::SetupRiver> rivers;
+  for (const auto& site : json[SITES]) {
+    sites.push_back(site[ID].asInt());
+  }
   for (const auto& mine : json[MINES]) {
-    int mine_id = mine.asInt();
-    id_map[mine_id] = cur_id++;
-    reverse_id_map.push_back(mine_id);
+    mines.push_back(mine.asInt());
   }
+  for (const auto& river : json[RIVERS]) {
+    rivers.emplace_back(river[SOURCE].asInt(), river[TARGET].asInt(),
+                        river.isMember(PUNTER) ? river[PUNTER].asInt() : -1);
+  }
+  return from_setup(sites, mines, rivers);
+}
 
-  for (const auto& site : json[SITES]) {
-    int site_id = site[ID].asInt();
-    if (id_map.count(site_id)) continue;
-    id_map[site_id] = cur_id++;
+std::tuple<Graph, IdMap>
+Graph::from_setup(const std::vector<int>& sites, const std::vector<int>& mines,
+                  const std::vector<protocol::SetupRiver>& rivers) {
+  Graph g;
+
+  g.num_mines = mines.size();
+  g.num_vertices = sites.size();
+  g.num_edges = rivers.size();
+
+  // mines first, then the other sites in input order
+  std::vector<int> sorted_mines(mines);
+  std::sort(sorted_mines.begin(), sorted_mines.end());
+  std::vector<int> reverse_id_map(mines);
+  reverse_id_map.reserve(sites.size());
+  for (const int site_id : sites) {
+    if (std::binary_search(sorted_mines.begin(), sorted_mines.end(), site_id)) continue;
     reverse_id_map.push_back(site_id);
   }
+  IdMap id_map(std::move(reverse_id_map));
 
   g.rivers.resize(g.num_vertices);
-  for (const auto& river : json[RIVERS]) {
-    int source = id_map[river[SOURCE].asInt()];
-    int target = id_map[river[TARGET].asInt()];
-    int punter = river.isMember(PUNTER) ? river[PUNTER].asInt() : -1;
-    g.rivers[source].emplace_back(target, punter);
-    g.rivers[target].emplace_back(source, punter);
+  for (const auto& river : rivers) {
+    int source = id_map[river.source];
+    int target = id_map[river.target];
+    g.rivers[source].emplace_back(target, river.punter);
+    g.rivers[target].emplace_back(source, river.punter);
   }
   for (int i = 0; i < g.num_vertices; ++i) {
     std::sort(g.rivers[i].begin(), g.rivers[i].end());
   }
 
-  return std::tuple<Graph, std::vector<int>, std::map<int, int>>(g, reverse_id_map, id_map);
+  return std::tuple<Graph, IdMap>(std::move(g), std::move(id_map));
 }
 
 Json::Value
@@ -243,33 +334,116 @@ Graph::to_json() const {
 }
 
 std::vector<std::vector<int>>
-Graph::calc_shortest_distances() const {
-  int num_edges = 0;
-  for (int i = 0; i < num_vertices; ++i) {
-    num_edges += rivers[i].size();
+Graph::calc_shortest_distances(DistanceMethod method) const {
+  turn_stats::ScopedTimer timer(turn_stats::SHORTEST_DISTANCES);
+  std::vector<std::vector<int>> distances(num_mines, std::vector<int>(num_vertices, 1<<29));
+
+  // the heads of the rivers of u are neighbors[offsets[u] .. offsets[u + 1])
+  std::vector<int> offsets(num_vertices + 1, 0), neighbors;
+  neighbors.reserve(2 * num_edges);
+  for (int u = 0; u < num_vertices; ++u) {
+    for (const River& river : rivers[u]) {
+      neighbors.push_back(river.to);
+    }
+    offsets[u + 1] = neighbors.size();
   }
-  std::unique_ptr<int[]> que(new int[(num_edges /= 2) + 1]);
 
-  std::vector<std::vector<int>> distances;
-  for (int mine = 0; mine < num_mines; ++mine) {
-    // calculate shortest distances from a mine
-    std::vector<int> dist(num_vertices, 1<<29);
+  // calculate shortest distances from a mine, using the queue |que| of
+  // num_vertices entries; returns the largest finite one
+  auto bfs_from = [&](int mine, std::vector<int>& que) {
+    turn_stats::count(turn_stats::BFS);
+    std::vector<int>& dist = distances[mine];
     int qb = 0, qe = 0;
     que[qe++] = mine;
     dist[mine] = 0;
     while (qb < qe) {
       const int u = que[qb++];
-      for (const River& river : rivers[u]) {
-        const int v = river.to;
-        if (dist[v] > dist[u] + 1) {
-          dist[v] = dist[u] + 1;
+      const int du = dist[u] + 1;
+      for (int h = offsets[u]; h < offsets[u + 1]; ++h) {
+        const int v = neighbors[h];
+        if (dist[v] > du) {
+          dist[v] = du;
           que[qe++] = v;
         }
       }
     }
-    distances.push_back(std::move(dist));
+    return dist[que[qe - 1]];
+  };
+
+  // the same for the mines [first, last), at most 64 of them: bit i of
+  // a vertex's masks stands for mine first + i, so one pass over a
+  // frontier vertex advances every search that reached it at this distance
+  auto bit_parallel_bfs = [&](int first, int last) {
+    std::vector<uint64_t> seen(num_vertices), frontier(num_vertices), next(num_vertices);
+    std::vector<int> active, touched;
+    turn_stats::count(turn_stats::BFS);
+    for (int mine = first; mine < last; ++mine) {
+      const uint64_t bit = 1ULL << (mine - first);
+      seen[mine] = frontier[mine] = bit;
+      distances[mine][mine] = 0;
+      active.push_back(mine);
+    }
+
+    for (int d = 1; !active.empty(); ++d) {
+      touched.clear();
+      for (const int u : active) {
+        const uint64_t f = frontier[u];
+        frontier[u] = 0;
+        for (int h = offsets[u]; h < offsets[u + 1]; ++h) {
+          const int v = neighbors[h];
+          const uint64_t add = f & ~seen[v];
+          if (add) {
+            if (!next[v]) {
+              touched.push_back(v);
+            }
+            next[v] |= add;
+          }
+        }
+      }
+      for (const int v : touched) {
+        uint64_t reached = next[v];
+        next[v] = 0;
+        seen[v] |= reached;
+        frontier[v] = reached;
+        while (reached) {
+          distances[first + __builtin_ctzll(reached)][v] = d;
+          reached &= reached - 1;
+        }
+      }
+      active.swap(touched);
+    }
+  };
+
+  int done = 0;
+  if (method == DistanceMethod::AUTO && num_mines > 1) {
+    // a bit-parallel pass touches a vertex once per distinct distance to
+    // its mines, at most the depth of the map, instead of once per mine; it
+    // pays off when there are more mines left than levels
+    std::vector<int> que(num_vertices);
+    const int depth = bfs_from(0, que);
+    done = 1;
+    if (num_mines - done > depth) {
+      method = DistanceMethod::BIT_PARALLEL;
+    }
   }
 
+  // the searches write disjoint rows, so they run on the thread pool once
+  // there is enough work to outweigh waking it
+  ThreadPool serial(1);
+  ThreadPool& pool = (int64_t)(num_mines - done) * (num_vertices + 2 * num_edges) >= PARALLEL_BFS_WORK
+    ? ThreadPool::shared() : serial;
+  if (method == DistanceMethod::BIT_PARALLEL) {
+    const int batches = (num_mines - done + 63) / 64;
+    pool.parallel_for(batches, [&](int batch, int) {
+      const int first = done + 64 * batch;
+      bit_parallel_bfs(first, std::min(num_mines, first + 64));
+    });
+  } else {
+    std::vector<std::vector<int>> ques(pool.size(), std::vector<int>(num_vertices));
+    pool.parallel_for(num_mines - done, [&](int i, int worker) {
+      bfs_from(done + i, ques[worker]);
+    });
+  }
   return distances;
 }
 
@@ -287,84 +461,72 @@ Graph::evaluate(
   const std::vector<std::vector<int>>& distances,
   int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
   int calc_punter) const {
-  std::vector<int64_t> scores(num_punters, 0LL);
-
-  const int MAX_EDGE = 2e4;
-  int que_array[MAX_EDGE];
-  std::unique_ptr<int[]> que_deleter;
-  int* que = que_array;
-
-  if (num_edges + 1 > MAX_EDGE) {
-    que_deleter.reset(new int[num_edges + 1]);
-    que = que_deleter.get();
-  }
+  static thread_local EvalWorkspace workspace;
+  return evaluate(workspace, num_punters, distances, my_punter_id, futures, future_score, calc_punter);
+}
 
-  std::unique_ptr<int[]> nxt_deleter;
-  int nxt_array[MAX_EDGE];
-  int* nxt = nxt_array;
-  if (num_vertices > MAX_EDGE) {
-    nxt_deleter.reset(new int[num_vertices]);
-    nxt = nxt_deleter.get();
-  } else {
-    memset(nxt, 0, num_vertices * sizeof(nxt[0]));
-  }
+std::vector<int64_t>
+Graph::evaluate(
+  EvalWorkspace& workspace, int num_punters,
+  const std::vector<std::vector<int>>& distances, int calc_punter) const {
+  int64_t dummy;
+  return evaluate(workspace, num_punters, distances, -1, {}, dummy, calc_punter);
+}
 
-  // std::vector<std::vector<River>> es = rivers;
-  std::unique_ptr<River*[]> es_deleter;
-  River* es_array[MAX_EDGE];
-  River** es = es_array;
-  if (num_vertices > MAX_EDGE) {
-    es_deleter.reset(new River*[num_vertices]);
-    es = es_deleter.get();
-  }
+std::vector<int64_t>
+Graph::evaluate(
+  EvalWorkspace& workspace, int num_punters,
+  const std::vector<std::vector<int>>& distances,
+  int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+  int calc_punter) const {
+  return evaluate_with(workspace, num_punters, distances, my_punter_id, futures, future_score, calc_punter);
+}
 
-  River river_array[MAX_EDGE];
-  std::unique_ptr<River[]> river_deleter;
-  River* river_buf = river_array;
-  if (num_edges + num_mines * num_punters > MAX_EDGE) {
-    river_deleter.reset(new River[num_edges + num_mines * num_punters]);
-    river_buf = river_deleter.get();
-  }
+std::vector<int64_t>
+Graph::evaluate(
+  int num_punters, const DistanceTable& table, int calc_punter) const {
+  int64_t dummy;
+  return evaluate(num_punters, table, -1, {}, dummy, calc_punter);
+}
 
-  std::unique_ptr<int[]> rsize_deleter;
-  int rsize_array[MAX_EDGE];
-  int* rsize = rsize_array;
-  if (num_vertices > MAX_EDGE) {
-    rsize_deleter.reset(new int[num_vertices]);
-    rsize = rsize_array;
-  }
+std::vector<int64_t>
+Graph::evaluate(
+  int num_punters, const DistanceTable& table,
+  int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+  int calc_punter) const {
+  static thread_local EvalWorkspace workspace;
+  return evaluate(workspace, num_punters, table, my_punter_id, futures, future_score, calc_punter);
+}
 
-  for (int i = 0; i < num_vertices; ++i) {
-    rsize[i] = rivers[i].size();
-    es[i] = river_buf;
-    river_buf += rsize[i];
-    std::copy(rivers[i].begin(), rivers[i].end(), es[i]);
-    for (const auto& river : rivers[i]) {
-      if (river.option != -1) {
-        *river_buf = River(river.to, river.option);
-        ++river_buf;
-        ++rsize[i];
-      }
-    }
-    std::sort(es[i], es[i] + rsize[i], [] (const River& a, const River& b) {
-      return a.punter < b.punter;
-    });
-  }
+std::vector<int64_t>
+Graph::evaluate(
+  EvalWorkspace& workspace, int num_punters, const DistanceTable& table,
+  int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+  int calc_punter) const {
+  return evaluate_with(workspace, num_punters, table, my_punter_id, futures, future_score, calc_punter);
+}
 
-  std::unique_ptr<int[]> visited_deleter;
-  int visited_array[MAX_EDGE];
-  int* visited = visited_array;
-  if (num_vertices > MAX_EDGE) {
-    visited_deleter.reset(new int[num_vertices]);
-    visited = visited_array;
-  } else {
-    memset(visited, 0, num_vertices * sizeof(visited[0]));
-  }
+template<class Distances>
+std::vector<int64_t>
+Graph::evaluate_with(
+  EvalWorkspace& workspace, int num_punters, const Distances& distances,
+  int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+  int calc_punter) const {
+  turn_stats::count(turn_stats::EVALUATE);
+  std::vector<int64_t> scores(num_punters, 0LL);
 
+  workspace.prepare(*this);
+  const River* es = workspace.sorted.data();
+  const int* offsets = workspace.offsets.data();
+  const int* rsize = workspace.sizes.data();
+  int* que = workspace.que.data();
+  int* nxt = workspace.nxt.data();
+  char* visited = workspace.visited.data();
+  std::vector<char>& computed_mine = workspace.computed_mine;
+  std::fill(workspace.nxt.begin(), workspace.nxt.end(), 0);
 
   future_score = 0;
 
-
   int punter_start = 0;
   int punter_end = num_punters;
   if (calc_punter != -1) {
@@ -372,22 +534,25 @@ Graph::evaluate(
     punter_end = calc_punter + 1;
   }
 
+  int num_bfs = 0;
   for (int punter = punter_start; punter < punter_end; ++punter) {
-    std::vector<int> computed_mine(num_mines);
+    std::fill(computed_mine.begin(), computed_mine.end(), 0);
     for (int mine = 0; mine < num_mines; ++mine) {
       if (computed_mine[mine]) continue;
+      ++num_bfs;
 
       int qb = 0, qe = 0;
       que[qe++] = mine;
       visited[mine] = 1;
       while (qb < qe) {
         const int u = que[qb++];
+        const River* eu = es + offsets[u];
         const int usize = rsize[u];
-        while (nxt[u] < usize && es[u][nxt[u]].punter < punter) {
+        while (nxt[u] < usize && eu[nxt[u]].punter < punter) {
           ++nxt[u];
         }
-        for (int ei = nxt[u]; ei < usize && es[u][ei].punter == punter; ++ei) {
-          const int v = es[u][ei].to;
+        for (int ei = nxt[u]; ei < usize && eu[ei].punter == punter; ++ei) {
+          const int v = eu[ei].to;
           if (!visited[v]) {
             que[qe++] = v;
             visited[v] = 1;
@@ -404,15 +569,12 @@ Graph::evaluate(
 
 	computed_mine[tmine] = true;
 	if (punter == my_punter_id && futures[tmine] >= 0) {
-	  const int64_t dis = distances[tmine][futures[tmine]];
+	  const int64_t dis = mine_distance(distances, tmine, futures[tmine]);
 	  const bool future_ok = visited[futures[tmine]] == 1;
 	  future_score += (future_ok ? +1 : -1) * dis * dis * dis;
 	}
 
-	for (int i = 0; i < reach_cnt; ++i) {
-	  int d = distances[tmine][que[i]];
-	  scores[punter] += d * d;
-	}
+	scores[punter] += sum_squares(distances, tmine, que, reach_cnt, visited);
       }
 
       for (int i = 0; i < reach_cnt; ++i) {
@@ -420,10 +582,122 @@ Graph::evaluate(
       }
     }
   }
+  turn_stats::count(turn_stats::BFS, num_bfs);
 
   return scores;
 }
 
+void
+EvalWorkspace::prepare(const Graph& graph) {
+  const int n = graph.num_vertices;
+  bool relayout = n != num_vertices;
+  for (int u = 0; !relayout && u < n; ++u) {
+    relayout = (int)graph.rivers[u].size() * 2 != offsets[u + 1] - offsets[u];
+  }
+  if (relayout) {
+    num_vertices = n;
+    offsets.assign(n + 1, 0);
+    for (int u = 0; u < n; ++u) {
+      offsets[u + 1] = offsets[u] + 2 * graph.rivers[u].size();
+    }
+    sizes.assign(n, 0);
+    sorted.assign(offsets[n], Graph::River(-1));
+    // a river never points to -1, so every vertex is rebuilt below
+    cached.assign(offsets[n] / 2, Graph::River(-1));
+    que.assign(n, 0);
+    nxt.assign(n, 0);
+    visited.assign(DistanceTable::padded_size(n), 0);
+  }
+  computed_mine.resize(graph.num_mines);
+
+  for (int u = 0; u < n; ++u) {
+    const std::vector<Graph::River>& rs = graph.rivers[u];
+    Graph::River* old = &cached[offsets[u] / 2];
+    bool changed = false;
+    for (size_t i = 0; i < rs.size(); ++i) {
+      if (rs[i].to != old[i].to || rs[i].punter != old[i].punter || rs[i].option != old[i].option) {
+        changed = true;
+        break;
+      }
+    }
+    if (!changed) continue;
+
+    std::copy(rs.begin(), rs.end(), old);
+    Graph::River* es = &sorted[offsets[u]];
+    int size = 0;
+    for (const Graph::River& river : rs) {
+      es[size++] = river;
+    }
+    for (const Graph::River& river : rs) {
+      if (river.option != -1) {
+        es[size++] = Graph::River(river.to, river.option);
+      }
+    }
+    std::sort(es, es + size, [] (const Graph::River& a, const Graph::River& b) {
+      return a.punter < b.punter;
+    });
+    sizes[u] = size;
+  }
+}
+
+std::vector<std::vector<int64_t>>
+Graph::marginal_gains(
+  int punter, const DistanceTable& table, bool options) const {
+  turn_stats::count(turn_stats::GAINS);
+  IncrementalScorer scorer(1, table);
+  scorer.load(*this, punter);
+
+  std::vector<std::vector<int64_t>> gains(num_vertices);
+  for (int u = 0; u < num_vertices; ++u) {
+    gains[u].assign(rivers[u].size(), -1);
+    for (size_t j = 0; j < rivers[u].size(); ++j) {
+      const River& river = rivers[u][j];
+      const bool takable = river.punter == -1
+        || (options && river.punter != punter && river.option == -1);
+      if (takable) {
+        gains[u][j] = scorer.gain(0, u, river.to);
+      }
+    }
+  }
+  return gains;
+}
+
+std::vector<Graph::BestGain>
+Graph::best_gains(
+  int num_punters, const DistanceTable& table,
+  const std::function<bool(int, int)>& allowed) const {
+  turn_stats::count(turn_stats::GAINS, num_punters);
+
+  // the candidates are the same for every punter
+  std::vector<std::pair<int, int>> candidates;
+  for (int u = 0; u < num_vertices; ++u) {
+    for (const River& river : rivers[u]) {
+      if (u < river.to && river.punter == -1 && (!allowed || allowed(u, river.to))) {
+        candidates.emplace_back(u, river.to);
+      }
+    }
+  }
+
+  std::vector<BestGain> best(num_punters);
+  IncrementalScorer scorer(num_punters, table);
+  scorer.load(*this);
+  for (int punter = 0; punter < num_punters; ++punter) {
+    BestGain& b = best[punter];
+    int best_degree = -1;
+    for (const auto& c : candidates) {
+      const int64_t gain = scorer.gain(punter, c.first, c.second);
+      const int degree = rivers[c.second].size();
+      if (gain > b.gain || (b.src != -1 && gain == b.gain && degree > best_degree)) {
+        b.src = c.first;
+        b.to = c.second;
+        b.gain = gain;
+        best_degree = degree;
+      }
+    }
+  }
+  return best;
+}
+
 int64_t
 Graph::evaluate_future(
   int punter_id, const std::vector<int>& futures,
@@ -442,6 +716,7 @@ Graph::evaluate_future(
     if (futures[mine] < 0) {
       continue;
     }
+    turn_stats::count(turn_stats::BFS);
     int reach_cnt = 0;
     int qb = 0, qe = 0;
     que[qe++] = mine;
@@ -560,167 +835,629 @@ Game::handshake() const {
   json[ME] = myname;
   json_helper::write_json(json);
 
-  json = json_helper::read_json();
+  const char* payload;
+  size_t length;
+  protocol::stdin_reader().next(payload, length);
+}
+
+Game::Game()
+  : binary_state(true), map_cached(false), map_hash(0), persistent(false),
+    last_message(protocol::UNKNOWN) {
+  const char* format = getenv("PUNTER_STATE_FORMAT");
+  if (format && strcmp(format, "json") == 0) {
+    binary_state = false;
+  }
+  const char* mode = getenv("PUNTER_PERSISTENT");
+  if (mode && strcmp(mode, "1") == 0) {
+    persistent = true;
+  }
 }
 
 void
 Game::run() {
+  const char* zygote_path = getenv("PUNTER_ZYGOTE");
+  if (zygote_path) {
+    run_zygote(zygote_path);
+    return;
+  }
+
   handshake();
 
-  Json::Value json = json_helper::read_json();
+  protocol::Writer out;
+  const char* payload;
+  size_t length;
+  while (read_message(payload, length) && handle_message(payload, length, out)) {
+    if (!out.empty()) {
+      turn_stats::ScopedTimer timer(turn_stats::WRITE);
+      out.flush(1);
+    }
+    emit_turn_stats();
+    if (!persistent) {
+      break;
+    }
+  }
+}
 
-  Json::Value res;
+bool
+Game::read_message(const char*& payload, size_t& length) {
+  if (persistent) {
+    // the read waits for the other punters; the turn starts when it
+    // returns, unless the message was already waiting while an overrun
+    // move() ran on: then it may have come as early as the fallback reply
+    const bool waited = overran && protocol::stdin_reader().pending();
+    overran = false;
+    const bool received = protocol::stdin_reader().next(payload, length);
+    turn_start = waited ? fallback_state.sent : Clock::now();
+    turn_stats::begin_turn();
+    return received;
+  }
+  turn_start = Clock::now();
+  turn_stats::begin_turn();
+  turn_stats::ScopedTimer timer(turn_stats::READ);
+  return protocol::stdin_reader().next(payload, length);
+}
 
-  if (json.isMember(PUNTER)) {  // Setup
-    punter_id = json[PUNTER].asInt();
-    num_punters = json[PUNTERS].asInt();
+void
+Game::emit_turn_stats() const {
+  if (!turn_stats::enabled()) {
+    return;
+  }
+  char hash[32];
+  snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)map_hash);
+
+  Json::Value context;
+  context["ai"] = name();
+  context["message"] = last_message == protocol::SETUP ? "setup" : "move";
+  context["punter"] = punter_id;
+  context["punters"] = num_punters;
+  context["turn"] = (int)history.size();
+  context["sites"] = graph.num_vertices;
+  context["rivers"] = graph.num_edges;
+  context["mines"] = graph.num_mines;
+  context["map_hash"] = hash;
+  context["state"] = persistent ? "persistent" : !binary_state ? "json" : map_cached ? "cached" : "binary";
+  turn_stats::emit(context);
+}
 
-    std::tie(graph, reverse_id_map, id_map) = Graph::from_json_setup(json[MAP]);
-    shortest_distances = graph.calc_shortest_distances();
+void
+Game::run_zygote(const char* path) {
+  const auto warm_up = [](const std::string& message) {
+    uint64_t hash;
+    if (peek_map_hash(message, hash)) {
+      map_cache::preload(hash);
+    }
+  };
+  int conn;
+  std::string message;
+  if (!zygote::serve(path, name(), warm_up, conn, message)) {
+    return;
+  }
+  // forked child: one turn on the connection
+  turn_start = Clock::now();
+  turn_stats::begin_turn();
+  reply_fd = conn;
+  protocol::Writer out;
+  if (handle_message(message.data(), message.size(), out) && !out.empty()) {
+    {
+      turn_stats::ScopedTimer timer(turn_stats::WRITE);
+      out.flush(conn);
+    }
+    emit_turn_stats();
+  }
+  close(conn);
+}
 
-    history = History();
-    first_turn = true;
+bool
+Game::handle_message(const char* payload, size_t length, protocol::Writer& out) {
+  turn_stats::ScopedTimer parse_timer(turn_stats::READ);
+  const protocol::MessageType type = protocol::message_type(payload, length);
+  last_message = type;
+  if (type == protocol::SETUP) {
+    protocol::SetupMessage msg;
+    if (protocol::parse_setup(payload, length, msg)) {
+      parse_timer.stop();
+      handle_setup(msg, out);
+    } else {
+      Json::Value json;
+      Json::Reader().parse(payload, payload + length, json);
+      parse_timer.stop();
+      handle_setup(json, out);
+    }
+  } else if (type == protocol::MOVE) {
+    protocol::MoveMessage msg;
+    if (protocol::parse_move(payload, length, msg)) {
+      parse_timer.stop();
+      handle_move(msg, out);
+    } else {
+      Json::Value json;
+      Json::Reader().parse(payload, payload + length, json);
+      parse_timer.stop();
+      handle_move(json, out);
+    }
+  } else if (type == protocol::STOP) {
+    return false;
+  } else {
+    out.json(Json::Value());
+  }
+  return true;
+}
 
-    futures_enabled = false;
-    splurges_enabled = false;
-    options_enabled = false;
-    if (json.isMember(SETTINGS)) {
-      const Json::Value& settings = json[SETTINGS];
-      if (settings.isMember(FUTURES)) {
-        futures_enabled = settings[FUTURES].asBool();
-      }
-      if (settings.isMember(SPLURGES)) {
-        splurges_enabled = settings[SPLURGES].asBool();
-      }
-      if (settings.isMember(OPTIONS)) {
-        options_enabled = settings[OPTIONS].asBool();
+void
+Game::handle_setup(const Json::Value& json, protocol::Writer& out) {
+  protocol::SetupMessage msg;
+  msg.punter = json[PUNTER].asInt();
+  msg.punters = json[PUNTERS].asInt();
+  for (const auto& site : json[MAP][SITES]) {
+    msg.sites.push_back(site[ID].asInt());
+  }
+  for (const auto& mine : json[MAP][MINES]) {
+    msg.mines.push_back(mine.asInt());
+  }
+  for (const auto& river : json[MAP][RIVERS]) {
+    msg.rivers.emplace_back(river[SOURCE].asInt(), river[TARGET].asInt(),
+                            river.isMember(PUNTER) ? river[PUNTER].asInt() : -1);
+  }
+
+  if (json.isMember(SETTINGS)) {
+    const Json::Value& settings = json[SETTINGS];
+    msg.futures = settings.isMember(FUTURES) && settings[FUTURES].asBool();
+    msg.splurges = settings.isMember(SPLURGES) && settings[SPLURGES].asBool();
+    msg.options = settings.isMember(OPTIONS) && settings[OPTIONS].asBool();
+  }
+  handle_setup(msg, out);
+}
+
+void
+Game::handle_move(const Json::Value& json, protocol::Writer& out) {
+  protocol::MoveMessage msg;
+  for (const Json::Value& mv : json[MOVE][MOVES]) {
+    if (mv.isMember(CLAIM)) {
+      msg.moves.emplace_back(protocol::ProtocolMove::CLAIM, mv[CLAIM][PUNTER].asInt());
+      msg.moves.back().source = mv[CLAIM][SOURCE].asInt();
+      msg.moves.back().target = mv[CLAIM][TARGET].asInt();
+    } else if (mv.isMember(SPLURGE)) {
+      msg.moves.emplace_back(protocol::ProtocolMove::SPLURGE, mv[SPLURGE][PUNTER].asInt());
+      for (const Json::Value& v : mv[SPLURGE][ROUTE]) {
+        msg.moves.back().route.push_back(v.asInt());
       }
+    } else if (mv.isMember(OPTION)) {
+      msg.moves.emplace_back(protocol::ProtocolMove::OPTION, mv[OPTION][PUNTER].asInt());
+      msg.moves.back().source = mv[OPTION][SOURCE].asInt();
+      msg.moves.back().target = mv[OPTION][TARGET].asInt();
+    } else {
+      msg.moves.emplace_back(protocol::ProtocolMove::PASS, mv[PASS][PUNTER].asInt());
     }
+  }
 
-    const SetupSettings& setup_result = setup();
-    const Json::Value next_info = setup_result.info;
+  msg.has_state = json.isMember(STATE);
+  const Json::Value& state = json[STATE];
+  if (state.isMember(STATE_BLOB)) {
+    msg.state_blob = state[STATE_BLOB].asString();
+  } else {
+    msg.legacy_state = true;
+    msg.state = state;
+  }
+  msg.info = state[INFO];
+  handle_move(msg, out);
+}
 
-    {
-      Json::Value futures_json;
-      futures = setup_result.futures;
-      while ((int)futures.size() < graph.num_mines) {
-        futures.push_back(-1);
-      }
-      if (futures_enabled) {
-        futures_json.resize(0);
-        for (int i = 0; i < graph.num_mines; ++i) {
-          if (futures[i] >= 0) {
-            Json::Value future;
-            future[SOURCE] = reverse_id_map[i];
-            future[TARGET] = reverse_id_map[futures[i]];
-            futures_json.append(future);
-          }
+void
+Game::handle_setup(const protocol::SetupMessage& msg, protocol::Writer& out) {
+  punter_id = msg.punter;
+  num_punters = msg.punters;
+
+  std::tie(graph, id_map) = Graph::from_setup(msg.sites, msg.mines, msg.rivers);
+  const auto distances = graph.calc_shortest_distances();
+  set_shortest_distances(distances);
+
+  map_hash = map_cache::hash_map(msg);
+  map_cached = binary_state && !persistent && map_cache::store(map_hash, graph, id_map, distances);
+
+  history = History();
+  first_turn = true;
+
+  futures_enabled = msg.futures;
+  splurges_enabled = msg.splurges;
+  options_enabled = msg.options;
+
+  set_deadline(env_ms("PUNTER_SETUP_BUDGET_MS", DEFAULT_SETUP_BUDGET_MS), 0);
+  turn_stats::ScopedTimer move_timer(turn_stats::MOVE);
+  const SetupSettings& setup_result = setup();
+  move_timer.stop();
+  const Json::Value next_info = setup_result.info;
+
+  out.begin_object();
+  out.key(READY).integer(punter_id);
+  {
+    futures = setup_result.futures;
+    while ((int)futures.size() < graph.num_mines) {
+      futures.push_back(-1);
+    }
+    if (futures_enabled) {
+      out.key(FUTURES).begin_array();
+      for (int i = 0; i < graph.num_mines; ++i) {
+        if (futures[i] >= 0) {
+          out.begin_object();
+          out.key(SOURCE).integer(id_map.original(i));
+          out.key(TARGET).integer(id_map.original(futures[i]));
+          out.end_object();
         }
-        res[FUTURES] = futures_json;
       }
+      out.end_array();
     }
-    splurge_length = 1;
-    options_bought = 0;
+  }
+  splurge_length = 1;
+  options_bought = 0;
 
-    const Json::Value state = encode_state(next_info);
+  if (persistent) {
+    info = next_info;
+  } else {
+    out.key(STATE);
+    write_state(out, next_info);
+  }
+  out.end_object();
+}
 
-    res[READY] = json[PUNTER];
-    res[STATE] = state;
-  } else if (json.isMember(MOVE)) {   // GamePlay
-    decode_state(json[STATE]);
+void
+Game::handle_move(const protocol::MoveMessage& msg, protocol::Writer& out) {
+  // in persistent mode the in-memory state is authoritative
+  const Clock::time_point decode_start = Clock::now();
+  if (!persistent) {
+    turn_stats::ScopedTimer timer(turn_stats::DECODE);
+    bool ok = msg.has_state;
+    if (ok && msg.legacy_state) {
+      ok = decode_state(msg.state);
+    } else if (ok) {
+      std::string blob;
+      ok = state_codec::base64_decode(msg.state_blob, blob)
+        && decode_state_binary(blob);
+      info = msg.info;
+    }
+    if (!ok) {
+      timer.stop();
+      reply_undecodable(msg, out);
+      return;
+    }
+  }
 
-    const Json::Value moves = json[MOVE][MOVES];
-    for (const Json::Value& mv : moves) {
-      if (mv.isMember(CLAIM)) {
-        const int p = mv[CLAIM][PUNTER].asInt();
-        const int src = id_map[mv[CLAIM][SOURCE].asInt()];
-        const int to = id_map[mv[CLAIM][TARGET].asInt()];
-        history.emplace_back(p, src, to);
+  for (const protocol::ProtocolMove& mv : msg.moves) {
+    const int p = mv.punter;
+    if (mv.kind == protocol::ProtocolMove::CLAIM) {
+      const int src = id_map[mv.source];
+      const int to = id_map[mv.target];
+      history.emplace_back(p, src, to);
+      auto& rs = graph.rivers[src];
+      auto& rt = graph.rivers[to];
+      std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->punter = p;
+      std::lower_bound(rt.begin(), rt.end(), Graph::River{src})->punter = p;
+    } else if (mv.kind == protocol::ProtocolMove::SPLURGE) {
+      std::vector<int> path;
+      for (const int v : mv.route) {
+        path.push_back(id_map[v]);
+      }
+      history.emplace_back(p, path);
+      for (int i = 0; i + 1 < (int)path.size(); ++i) {
+        const int src = path[i];
+        const int to = path[i + 1];
         auto& rs = graph.rivers[src];
         auto& rt = graph.rivers[to];
         std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->punter = p;
         std::lower_bound(rt.begin(), rt.end(), Graph::River{src})->punter = p;
-      } else if (mv.isMember(SPLURGE)) {
-        const int p = mv[CLAIM][PUNTER].asInt();
-        std::vector<int> path;
-        for (const Json::Value& v : mv[SPLURGE][ROUTE]) {
-          path.push_back(id_map[v.asInt()]);
-        }
-        history.emplace_back(p, path);
-        for (int i = 0; i + 1 < (int)path.size(); ++i) {
-          const int src = path[i];
-          const int to = path[i + 1];
-          auto& rs = graph.rivers[src];
-          auto& rt = graph.rivers[to];
-          std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->punter = p;
-          std::lower_bound(rt.begin(), rt.end(), Graph::River{src})->punter = p;
-        }
-      } else if (mv.isMember(OPTION)) {
-        const int p = mv[OPTION][PUNTER].asInt();
-        const int src = id_map[mv[OPTION][SOURCE].asInt()];
-        const int to = id_map[mv[OPTION][TARGET].asInt()];
-        history.emplace_back(p, src, to);
-        auto& rs = graph.rivers[src];
-        auto& rt = graph.rivers[to];
-        std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->option = p;
-        std::lower_bound(rt.begin(), rt.end(), Graph::River{src})->option = p;
-      } else {
-        const int p = mv[PASS][PUNTER].asInt();
-        if (!first_turn || p < punter_id) {
-          history.emplace_back(p, -1, -1);
-        }
+      }
+    } else if (mv.kind == protocol::ProtocolMove::OPTION) {
+      const int src = id_map[mv.source];
+      const int to = id_map[mv.target];
+      history.emplace_back(p, src, to);
+      auto& rs = graph.rivers[src];
+      auto& rt = graph.rivers[to];
+      std::lower_bound(rs.begin(), rs.end(), Graph::River{to})->option = p;
+      std::lower_bound(rt.begin(), rt.end(), Graph::River{src})->option = p;
+    } else {
+      if (!first_turn || p < punter_id) {
+        history.emplace_back(p, -1, -1);
       }
     }
+  }
 
-    StartProfilerWrapper(punter_id, name(), history.size());
-    MoveResult move_res = move();
-    StopProfilerWrapper();
+  // the decode time is also reserved for encoding the reply
+  const int decode_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+    Clock::now() - decode_start).count();
+  set_deadline(env_ms("PUNTER_MOVE_BUDGET_MS", DEFAULT_MOVE_BUDGET_MS), decode_ms);
+
+  const bool guarded = env_ms("PUNTER_WATCHDOG", 1) != 0;
+  if (guarded) {
+    const int budget_ms = env_ms("PUNTER_MOVE_BUDGET_MS", DEFAULT_MOVE_BUDGET_MS);
+    const int reserve_ms = env_ms("PUNTER_RESERVE_MS", DEFAULT_RESERVE_MS);
+    snapshot_fallback();
+    watched_game = this;
+    update_best_move(MoveResult(Json::Value()));
+    const auto fallback = []() {
+      TurnState next;
+      const std::string reply = fallback_reply(next, fallback_state.info);
+      fallback_state.splurge_length = next.splurge_length;
+      fallback_state.options_bought = next.options_bought;
+      fallback_state.sent = Clock::now();
+      return reply;
+    };
+    // the process ends right after the fallback unless it is persistent
+    const auto before_exit = [this]() { emit_turn_stats(); };
+    watchdog.arm(turn_start + std::chrono::milliseconds(budget_ms - reserve_ms / 2),
+                 reply_fd, !persistent, fallback, before_exit);
+  }
 
-    Json::Value json_move;
-    if (!move_res.splurge_path.empty()) {
-      res[SPLURGE][PUNTER] = punter_id;
-      for (const int u : move_res.splurge_path) {
-        res[SPLURGE][ROUTE].append(reverse_id_map[u]);
-      }
-      for (int i = 0; i+1 < (int)move_res.splurge_path.size(); ++i) {
-        const int u = move_res.splurge_path[i];
-        const int v = move_res.splurge_path[i + 1];
-        if (graph.owner(u, v) != -1) {
-          ++options_bought;
-        }
-      }
-      splurge_length = 1;
-    } else if (move_res.src == -1) {
-      res[PASS][PUNTER] = punter_id;
-      ++splurge_length;
-    } else {
-      const bool opt = graph.owner(move_res.src, move_res.to) != -1;
-      const char* MV = opt ? OPTION : CLAIM;
-      res[MV][PUNTER] = punter_id;
-      res[MV][SOURCE] = reverse_id_map[move_res.src];
-      res[MV][TARGET] = reverse_id_map[move_res.to];
-      splurge_length = 1;
-      if (opt) {
-        ++options_bought;
+  StartProfilerWrapper(punter_id, name(), history.size());
+  turn_stats::ScopedTimer move_timer(turn_stats::MOVE);
+  MoveResult move_res = move();
+  move_timer.stop();
+  StopProfilerWrapper();
+
+  if (guarded) {
+    watched_game = nullptr;
+    if (watchdog.disarm()) {
+      // persistent mode: the fallback reply is already sent
+      splurge_length = fallback_state.splurge_length;
+      options_bought = fallback_state.options_bought;
+      info = fallback_state.info;
+      first_turn = false;
+      overran = true;
+      return;
+    }
+  }
+  finish_move(move_res, out);
+}
+
+void
+Game::reply_undecodable(const protocol::MoveMessage& msg, protocol::Writer& out) {
+  // the game cannot be trusted, so nothing is searched; the state goes back
+  // as it came, and punter_id is whatever the decoding got to
+  std::cerr << "the state cannot be decoded; passing" << std::endl;
+  out.begin_object();
+  out.key(PASS).begin_object();
+  out.key(PUNTER).integer(punter_id);
+  out.end_object();
+  out.key(STATE);
+  if (msg.legacy_state) {
+    out.json(msg.state);
+  } else {
+    out.begin_object();
+    out.key(STATE_BLOB).string(msg.state_blob);
+    out.key(INFO).json(msg.info);
+    out.end_object();
+  }
+  out.end_object();
+}
+
+void
+Game::finish_move(const MoveResult& move_res, protocol::Writer& out) {
+  TurnState next;
+  write_reply(move_res, out, true, next);
+  first_turn = false;
+  splurge_length = next.splurge_length;
+  options_bought = next.options_bought;
+  if (persistent) {
+    info = move_res.info;
+  }
+}
+
+void
+Game::write_reply(const MoveResult& move_res, protocol::Writer& out, bool with_search, TurnState& next) const {
+  next = turn_state();
+  next.first_turn = false;
+  next.with_search = with_search;
+  const char* kind;
+  std::vector<int> route;
+  resolve_move(move_res, kind, route, next);
+  out.begin_object();
+  write_move(out, kind, punter_id, route);
+  if (!persistent) {
+    out.key(STATE);
+    write_next_state(out, move_res.info, next);
+  }
+  out.end_object();
+}
+
+void
+Game::resolve_move(const MoveResult& move_res, const char*& kind, std::vector<int>& route, TurnState& next) const {
+  route.clear();
+  if (!move_res.splurge_path.empty()) {
+    kind = SPLURGE;
+    for (const int u : move_res.splurge_path) {
+      route.push_back(id_map.original(u));
+    }
+    for (int i = 0; i+1 < (int)move_res.splurge_path.size(); ++i) {
+      const int u = move_res.splurge_path[i];
+      const int v = move_res.splurge_path[i + 1];
+      if (graph.owner(u, v) != -1) {
+        ++next.options_bought;
       }
     }
+    next.splurge_length = 1;
+  } else if (move_res.src == -1) {
+    kind = PASS;
+    ++next.splurge_length;
+  } else {
+    const bool opt = graph.owner(move_res.src, move_res.to) != -1;
+    kind = opt ? OPTION : CLAIM;
+    route.push_back(id_map.original(move_res.src));
+    route.push_back(id_map.original(move_res.to));
+    next.splurge_length = 1;
+    if (opt) {
+      ++next.options_bought;
+    }
+  }
+}
 
-    first_turn = false;
-    res[STATE] = encode_state(move_res.info);
+void
+Game::set_deadline(int budget_ms, int decode_ms) {
+  const int reserve_ms = env_ms("PUNTER_RESERVE_MS", DEFAULT_RESERVE_MS) + decode_ms;
+  turn_deadline = turn_start + std::chrono::milliseconds(budget_ms - reserve_ms);
+  deadline_set = true;
+}
+
+std::chrono::steady_clock::time_point
+Game::deadline() const {
+  if (!deadline_set) {
+    // outside of run(), e.g. an AI driven by an experiment tool
+    return Clock::now() + std::chrono::milliseconds(
+      env_ms("PUNTER_MOVE_BUDGET_MS", DEFAULT_MOVE_BUDGET_MS) - env_ms("PUNTER_RESERVE_MS", DEFAULT_RESERVE_MS));
   }
+  return turn_deadline;
+}
+
+int
+Game::remaining_ms() const {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(deadline() - Clock::now()).count();
+}
 
-  if (!json.isMember(STOP)) {
-    json_helper::write_json(res);
+void
+Game::update_best_move(const MoveResult& move) const {
+  if (watched_game) {
+    // resolved here, as the watchdog must not read the game
+    TurnState next = turn_state();
+    const char* kind;
+    std::vector<int> route;
+    resolve_move(move, kind, route, next);
+    std::lock_guard<std::mutex> lock(best_move_mutex);
+    best_move.kind = kind;
+    best_move.route.swap(route);
+    best_move.splurge_length = next.splurge_length;
+    best_move.options_bought = next.options_bought;
+    best_move.info = move.info;
+  }
+}
+
+bool
+Game::time_is_up() const {
+  return remaining_ms() <= 0 || watchdog.fired();
+}
+
+std::string&
+Game::carried_search() {
+  static std::string search;
+  return search;
+}
+
+void
+Game::snapshot_fallback() {
+  turn_stats::ScopedTimer timer(turn_stats::ENCODE);
+  fallback_state.punter_id = punter_id;
+  fallback_state.persistent = persistent;
+  fallback_state.prev_info = info;
+  fallback_state.binary = binary_state;
+  if (persistent) {
+    return;  // the reply carries no state
+  }
+  if (binary_state) {
+    state_codec::Writer head, body;
+    encode_state_head(head, false);
+    encode_state_body(body);
+    fallback_state.state_head = head.data();
+    fallback_state.state_body = body.data();
+  } else {
+    fallback_state.json_state = encode_state_json(Json::Value());
+    fallback_state.json_state[FIRST_TURN] = false;
+    fallback_state.json_state.removeMember(SEARCH);
   }
 }
 
+std::string
+Game::fallback_reply(TurnState& next, Json::Value& next_info) {
+  const char* kind;
+  std::vector<int> route;
+  {
+    std::lock_guard<std::mutex> lock(best_move_mutex);
+    kind = best_move.kind;
+    route = best_move.route;
+    next.splurge_length = best_move.splurge_length;
+    next.options_bought = best_move.options_bought;
+    next_info = best_move.info;
+  }
+  // a null info keeps the one of the previous turn
+  if (next_info.isNull()) {
+    next_info = fallback_state.prev_info;
+  }
+
+  protocol::Writer out;
+  out.begin_object();
+  write_move(out, kind, fallback_state.punter_id, route);
+  if (!fallback_state.persistent) {
+    out.key(STATE);
+    if (fallback_state.binary) {
+      // the layout of encode_state_binary(); the search data is left out,
+      // as move() may be writing it right now
+      state_codec::Writer turn, search;
+      turn.put_varint(next.splurge_length);
+      turn.put_varint(next.options_bought);
+      search.put_string(std::string());
+      out.begin_object();
+      out.key(STATE_BLOB).string(state_codec::base64_encode(
+        fallback_state.state_head + turn.data() + fallback_state.state_body + search.data()));
+      out.key(INFO).json(next_info);
+      out.end_object();
+    } else {
+      Json::Value state = fallback_state.json_state;
+      state[SPLURGE_LENGTH] = next.splurge_length;
+      state[OPTIONS_BOUGHT] = next.options_bought;
+      state[INFO] = next_info;
+      out.json(state);
+    }
+  }
+  out.end_object();
+  return out.message();
+}
+
 int
 Game::original_vertex_id(int vertex_id) const {
-  return reverse_id_map[vertex_id];
+  return id_map.original(vertex_id);
 }
 
 Json::Value
 Game::encode_state(const Json::Value& info) const {
+  turn_stats::ScopedTimer timer(turn_stats::ENCODE);
+  if (!binary_state) {
+    return encode_state_json(info);
+  }
+  Json::Value state;
+  state[STATE_BLOB] = state_codec::base64_encode(encode_state_binary(turn_state()));
+  state[INFO] = info;
+  return state;
+}
+
+void
+Game::write_state(protocol::Writer& out, const Json::Value& info) const {
+  write_next_state(out, info, turn_state());
+}
+
+void
+Game::write_next_state(protocol::Writer& out, const Json::Value& info, const TurnState& turn) const {
+  turn_stats::ScopedTimer timer(turn_stats::ENCODE);
+  if (!binary_state) {
+    write_state_json(out, info, turn);
+    return;
+  }
+  out.begin_object();
+  out.key(STATE_BLOB).string(state_codec::base64_encode(encode_state_binary(turn)));
+  out.key(INFO).json(info);
+  out.end_object();
+}
+
+bool
+Game::decode_state(Json::Value state) {
+  if (state.isMember(STATE_BLOB)) {
+    std::string blob;
+    if (!state_codec::base64_decode(state[STATE_BLOB].asString(), blob)
+        || !decode_state_binary(blob)) {
+      return false;
+    }
+  } else {
+    decode_state_json(state);
+  }
+  info = state[INFO];
+  return true;
+}
+
+Json::Value
+Game::encode_state_json(const Json::Value& info) const {
   Json::Value state;
   state[FIRST_TURN] = first_turn;
   state[NUM_PUNTERS] = num_punters;
@@ -730,7 +1467,7 @@ Game::encode_state(const Json::Value& info) const {
     state[HISTORY].append(mv.to_json());
   }
   for (int i = 0; i < graph.num_vertices; ++i) {
-    state[REVERSE_ID_MAP].append(reverse_id_map[i]);
+    state[REVERSE_ID_MAP].append(id_map.original(i));
   }
 
   state[FUTURES_ENABLED] = futures_enabled;
@@ -744,30 +1481,91 @@ Game::encode_state(const Json::Value& info) const {
   state[OPTIONS_ENABLED] = options_enabled;
   state[OPTIONS_BOUGHT] = options_bought;
 
+  if (!carried_search().empty()) {
+    state[SEARCH] = state_codec::base64_encode(carried_search());
+  }
+
   state[INFO] = info;
   return state;
 }
 
+// same layout as encode_state_json, without building the tree
 void
-Game::decode_state(Json::Value state) {
-  first_turn = state.isMember(FIRST_TURN);
+Game::write_state_json(protocol::Writer& out, const Json::Value& info, const TurnState& turn) const {
+  out.begin_object();
+  out.key(FIRST_TURN).boolean(turn.first_turn);
+  out.key(NUM_PUNTERS).integer(num_punters);
+  out.key(PUNTER_ID).integer(punter_id);
+
+  out.key(GRAPH).begin_object();
+  out.key(SITES).integer(graph.num_vertices);
+  out.key(MINES).integer(graph.num_mines);
+  out.key(RIVERS).begin_array();
+  for (int i = 0; i < graph.num_vertices; ++i) {
+    for (auto& river : graph.rivers[i]) if (i < river.to) {
+      out.begin_array();
+      out.integer(i).integer(river.to).integer(river.punter).integer(river.option);
+      out.end_array();
+    }
+  }
+  out.end_array();
+  out.end_object();
+
+  out.key(HISTORY).begin_array();
+  for (const Move& mv : history) {
+    out.begin_array();
+    out.integer(mv.punter).integer(mv.src).integer(mv.to);
+    for (const int v : mv.path) {
+      out.integer(v);
+    }
+    out.end_array();
+  }
+  out.end_array();
+
+  out.key(REVERSE_ID_MAP).begin_array();
+  for (int i = 0; i < graph.num_vertices; ++i) {
+    out.integer(id_map.original(i));
+  }
+  out.end_array();
+
+  out.key(FUTURES_ENABLED).boolean(futures_enabled);
+  out.key(FUTURES).begin_array();
+  for (const int f : futures) {
+    out.integer(f);
+  }
+  out.end_array();
+
+  out.key(SPLURGES_ENABLED).boolean(splurges_enabled);
+  out.key(SPLURGE_LENGTH).integer(turn.splurge_length);
+  out.key(OPTIONS_ENABLED).boolean(options_enabled);
+  out.key(OPTIONS_BOUGHT).integer(turn.options_bought);
+
+  if (turn.with_search && !carried_search().empty()) {
+    out.key(SEARCH).string(state_codec::base64_encode(carried_search()));
+  }
+
+  out.key(INFO).json(info);
+  out.end_object();
+}
+
+void
+Game::decode_state_json(const Json::Value& state) {
+  first_turn = state[FIRST_TURN].asBool();
   num_punters = state[NUM_PUNTERS].asInt();
   punter_id = state[PUNTER_ID].asInt();
   graph = Graph::from_json(state[GRAPH]);
-  shortest_distances = graph.calc_shortest_distances();
+  set_shortest_distances(graph.calc_shortest_distances());
 
   history = History();
   for (const Json::Value& mv : state[HISTORY]) {
     history.emplace_back(mv);
   }
 
-  id_map.clear();
-  reverse_id_map.clear();
+  std::vector<int> reverse_id_map(graph.num_vertices);
   for (int i = 0; i < graph.num_vertices; ++i) {
-    int org_id = state[REVERSE_ID_MAP][i].asInt();
-    id_map[org_id] = i;
-    reverse_id_map.push_back(org_id);
+    reverse_id_map[i] = state[REVERSE_ID_MAP][i].asInt();
   }
+  id_map = IdMap(std::move(reverse_id_map));
 
   futures_enabled = state[FUTURES_ENABLED].asBool();
   futures = std::vector<int>();
@@ -781,11 +1579,340 @@ Game::decode_state(Json::Value state) {
   options_enabled = state[OPTIONS_ENABLED].asBool();
   options_bought = state[OPTIONS_BOUGHT].asInt();
 
-  info = state[INFO];
+  carried_search().clear();
+  if (state.isMember(SEARCH)
+      && !state_codec::base64_decode(state[SEARCH].asString(), carried_search())) {
+    // the state comes from outside; a broken search only costs the tree
+    carried_search().clear();
+  }
+}
+
+/*
+ * binary state layout (all integers are varints):
+ *   format, flags, num_punters, punter_id, splurge_length, options_bought,
+ *   FORMAT_CACHED_MAP:
+ *     map hash (see MapCache.h); ownership is rebuilt by replaying history
+ *   FORMAT_EMBEDDED_MAP:
+ *     num_vertices, num_mines, reverse_id_map (zigzag delta),
+ *     for each vertex u: #rivers to larger ids, then the neighbours as deltas,
+ *     (punter + 1, option + 1) for each river in the same order,
+ *   futures (zigzag), history (punter, kind, payload),
+ *   carried_search() (length and bytes).
+ */
+namespace {
+  enum StateFlag {
+    FLAG_FIRST_TURN = 1,
+    FLAG_FUTURES = 2,
+    FLAG_SPLURGES = 4,
+    FLAG_OPTIONS = 8,
+  };
+
+  enum MoveKind {
+    MOVE_PASS = 0,
+    MOVE_CLAIM = 1,
+    MOVE_SPLURGE = 2,
+  };
+
+  // far above any real game; bounds what a corrupt state can allocate per
+  // punter
+  const int MAX_PUNTERS = 1024;
+
+  bool has_river(const Graph& graph, int src, int to) {
+    if (src < 0 || src >= graph.num_vertices || to < 0 || to >= graph.num_vertices) {
+      return false;
+    }
+    const auto& rs = graph.rivers[src];
+    const auto it = std::lower_bound(rs.begin(), rs.end(), Graph::River{to});
+    return it != rs.end() && it->to == to;
+  }
+
+  // the map hash of a move message with a cached-map state, read from the
+  // header of the blob only
+  bool peek_map_hash(const std::string& message, uint64_t& hash) {
+    static const char KEY[] = "\"blob\"";
+    const size_t key = message.find(KEY);
+    if (key == std::string::npos) {
+      return false;
+    }
+    const size_t begin = message.find('"', key + sizeof(KEY) - 1);
+    if (begin == std::string::npos) {
+      return false;
+    }
+    // six varints and the hash fit in 64 base64 characters
+    const size_t end = std::min(message.find('"', begin + 1), begin + 1 + 64);
+    std::string header;
+    if (!state_codec::base64_decode(message.substr(begin + 1, end - begin - 1), header)) {
+      return false;
+    }
+    state_codec::Reader r(header);
+    if (r.get_varint() != state_codec::FORMAT_CACHED_MAP) {
+      return false;
+    }
+    r.get_byte();
+    for (int i = 0; i < 4; ++i) {
+      r.get_varint();
+    }
+    hash = r.get_varint();
+    return r.good();
+  }
+
+  void encode_graph(state_codec::Writer& w, const Graph& graph, const IdMap& id_map) {
+    w.put_varint(graph.num_vertices);
+    w.put_varint(graph.num_mines);
+
+    int prev_id = 0;
+    for (int i = 0; i < graph.num_vertices; ++i) {
+      w.put_int((int64_t)id_map.original(i) - prev_id);
+      prev_id = id_map.original(i);
+    }
+
+    for (int u = 0; u < graph.num_vertices; ++u) {
+      const auto& rs = graph.rivers[u];
+      const int first = std::upper_bound(rs.begin(), rs.end(), Graph::River{u}) - rs.begin();
+      w.put_varint(rs.size() - first);
+      int prev = u;
+      for (int i = first; i < (int)rs.size(); ++i) {
+        w.put_varint(rs[i].to - prev);
+        prev = rs[i].to;
+      }
+    }
+    for (int u = 0; u < graph.num_vertices; ++u) {
+      for (const auto& river : graph.rivers[u]) if (u < river.to) {
+        w.put_varint(river.punter + 1);
+        w.put_varint(river.option + 1);
+      }
+    }
+  }
+
+  bool decode_graph(state_codec::Reader& r, int num_punters, Graph& graph, IdMap& id_map) {
+    const int num_vertices = r.get_count(INT_MAX);
+    const int num_mines = r.get_count(num_vertices);
+    if (!r.good()) {
+      return false;
+    }
+
+    std::vector<int> reverse_id_map(num_vertices);
+    int prev_id = 0;
+    for (int i = 0; i < num_vertices; ++i) {
+      prev_id += r.get_int();
+      reverse_id_map[i] = prev_id;
+    }
+    id_map = IdMap(std::move(reverse_id_map));
+
+    graph = Graph();
+    graph.num_vertices = num_vertices;
+    graph.num_mines = num_mines;
+    graph.num_edges = 0;
+    graph.rivers.assign(num_vertices, std::vector<Graph::River>());
+    for (int u = 0; u < num_vertices && r.good(); ++u) {
+      const int forward_count = r.get_count(num_vertices - 1 - u);
+      int prev = u;
+      for (int i = 0; i < forward_count && r.good(); ++i) {
+        const uint64_t delta = r.get_varint();
+        if (delta == 0 || delta >= (uint64_t)(num_vertices - prev)) {
+          return false;
+        }
+        const int v = prev + delta;
+        graph.rivers[u].emplace_back(v);
+        graph.rivers[v].emplace_back(u);
+        prev = v;
+      }
+      graph.num_edges += forward_count;
+    }
+    if (!r.good()) {
+      return false;
+    }
+    // rivers to smaller ids were appended in increasing order of the source
+    // before the rivers to larger ids, so every adjacency list is already sorted
+    for (int u = 0; u < num_vertices; ++u) {
+      for (auto& river : graph.rivers[u]) if (u < river.to) {
+        const uint64_t punter = r.get_varint();
+        const uint64_t option = r.get_varint();
+        if (punter > (uint64_t)num_punters || option > (uint64_t)num_punters) {
+          return false;
+        }
+        river.punter = (int)punter - 1;
+        river.option = (int)option - 1;
+        Graph::River& twin = graph.find_river(river.to, u);
+        twin.punter = river.punter;
+        twin.option = river.option;
+      }
+    }
+    return r.good();
+  }
+
+  // claims on an owned river can only be options, so the history alone
+  // determines the ownership of every river
+  void replay_history(Graph& graph, const History& history) {
+    for (const Move& mv : history) {
+      if (mv.is_splurge()) {
+        for (int i = 0; i + 1 < (int)mv.path.size(); ++i) {
+          graph.find_river(mv.path[i], mv.path[i + 1]).punter = mv.punter;
+          graph.find_river(mv.path[i + 1], mv.path[i]).punter = mv.punter;
+        }
+      } else if (mv.is_claim()) {
+        Graph::River& rs = graph.find_river(mv.src, mv.to);
+        Graph::River& rt = graph.find_river(mv.to, mv.src);
+        if (rs.punter == -1) {
+          rs.punter = rt.punter = mv.punter;
+        } else {
+          rs.option = rt.option = mv.punter;
+        }
+      }
+    }
+  }
+}
+
+std::string
+Game::encode_state_binary(const TurnState& turn) const {
+  state_codec::Writer w;
+  w.reserve((map_cached ? 0 : graph.num_vertices * 4 + graph.num_edges * 4) + history.size() * 4 + 64);
+
+  encode_state_head(w, turn.first_turn);
+  w.put_varint(turn.splurge_length);
+  w.put_varint(turn.options_bought);
+  encode_state_body(w);
+  w.put_string(turn.with_search ? carried_search() : std::string());
+  return w.data();
+}
+
+void
+Game::encode_state_head(state_codec::Writer& w, bool first_turn) const {
+  w.put_varint(map_cached ? state_codec::FORMAT_CACHED_MAP : state_codec::FORMAT_EMBEDDED_MAP);
+  w.put_byte((first_turn ? FLAG_FIRST_TURN : 0)
+             | (futures_enabled ? FLAG_FUTURES : 0)
+             | (splurges_enabled ? FLAG_SPLURGES : 0)
+             | (options_enabled ? FLAG_OPTIONS : 0));
+  w.put_varint(num_punters);
+  w.put_varint(punter_id);
+}
+
+void
+Game::encode_state_body(state_codec::Writer& w) const {
+  if (map_cached) {
+    w.put_varint(map_hash);
+  } else {
+    encode_graph(w, graph, id_map);
+  }
+
+  w.put_varint(futures.size());
+  for (const int f : futures) {
+    w.put_int(f);
+  }
+
+  w.put_varint(history.size());
+  for (const Move& mv : history) {
+    w.put_varint(mv.punter);
+    if (mv.is_splurge()) {
+      w.put_byte(MOVE_SPLURGE);
+      w.put_varint(mv.path.size());
+      for (const int v : mv.path) {
+        w.put_varint(v);
+      }
+    } else if (mv.is_claim()) {
+      w.put_byte(MOVE_CLAIM);
+      w.put_varint(mv.src);
+      w.put_varint(mv.to);
+    } else {
+      w.put_byte(MOVE_PASS);
+    }
+  }
+}
+
+bool
+Game::decode_state_binary(const std::string& blob) {
+  state_codec::Reader r(blob);
+
+  const int format = r.get_varint();
+  const int flags = r.get_byte();
+  first_turn = flags & FLAG_FIRST_TURN;
+  futures_enabled = flags & FLAG_FUTURES;
+  splurges_enabled = flags & FLAG_SPLURGES;
+  options_enabled = flags & FLAG_OPTIONS;
+  num_punters = r.get_varint();
+  punter_id = r.get_varint();
+  splurge_length = r.get_varint();
+  options_bought = r.get_varint();
+  if (!r.good() || num_punters < 1 || num_punters > MAX_PUNTERS
+      || punter_id < 0 || punter_id >= num_punters) {
+    return false;
+  }
+
+  if (format == state_codec::FORMAT_CACHED_MAP) {
+    map_hash = r.get_varint();
+    map_cached = true;
+    std::vector<std::vector<int>> distances;
+    if (!r.good() || !map_cache::load(map_hash, graph, id_map, distances)) {
+      std::cerr << "map cache is not available: " << map_cache::cache_path(map_hash) << std::endl;
+      return false;
+    }
+    set_shortest_distances(distances);
+  } else if (format == state_codec::FORMAT_EMBEDDED_MAP) {
+    map_cached = false;
+    if (!decode_graph(r, num_punters, graph, id_map)) {
+      return false;
+    }
+    set_shortest_distances(graph.calc_shortest_distances());
+  } else {
+    return false;
+  }
+
+  // every vertex and punter below is checked against the map, so that
+  // replaying the history cannot step outside of it
+  const uint64_t num_vertices = graph.num_vertices;
+  futures.assign(r.get_count(graph.num_mines), -1);
+  for (int& f : futures) {
+    const int64_t v = r.get_int();
+    if (v < -1 || v >= (int64_t)num_vertices) {
+      return false;
+    }
+    f = v;
+  }
+
+  history = History();
+  const int history_size = r.get_count(INT_MAX);
+  history.reserve(history_size);
+  for (int i = 0; i < history_size && r.good(); ++i) {
+    const uint64_t p = r.get_varint();
+    const int kind = r.get_byte();
+    if (p >= (uint64_t)num_punters) {
+      return false;
+    }
+    if (kind == MOVE_SPLURGE) {
+      std::vector<int> path(r.get_count(INT_MAX));
+      for (size_t j = 0; j < path.size(); ++j) {
+        const uint64_t v = r.get_varint();
+        if (v >= num_vertices || (j > 0 && !has_river(graph, path[j - 1], v))) {
+          return false;
+        }
+        path[j] = v;
+      }
+      history.emplace_back(p, path);
+    } else if (kind == MOVE_CLAIM) {
+      const uint64_t src = r.get_varint();
+      const uint64_t to = r.get_varint();
+      if (src >= num_vertices || to >= num_vertices || !has_river(graph, src, to)) {
+        return false;
+      }
+      history.emplace_back(p, src, to);
+    } else {
+      history.emplace_back(p, -1, -1);
+    }
+  }
+  carried_search() = r.get_string();
+  if (!r.good() || !r.at_end()) {
+    return false;
+  }
+
+  if (format == state_codec::FORMAT_CACHED_MAP) {
+    replay_history(graph, history);
+  }
+  return true;
 }
 
 void
 Game::calc_shortest_paths(int src, std::vector<int>& dist, std::vector<int>& prev) const {
+  turn_stats::count(turn_stats::BFS);
   std::deque<int> que;
   dist.assign(graph.num_vertices, INF);
   prev.assign(graph.num_vertices, -1);
@@ -814,21 +1941,42 @@ Game::calc_shortest_paths(int src, std::vector<int>& dist, std::vector<int>& pre
 }
 
 void
-Game::calc_cur_dists(std::vector<std::vector<int>>& dists, std::vector<std::vector<int>>& prevs) const {
-  dists.clear();
-  prevs.clear();
+Game::calc_cur_dists(DistanceMatrix& dists, std::vector<std::vector<int>>& prevs) const {
+  // a path claims at most num_vertices - 1 rivers
+  dists = DistanceMatrix(graph.num_mines, graph.num_vertices, graph.num_vertices - 1, INF);
+  prevs.assign(graph.num_mines, std::vector<int>());
 
-  for (int u = 0; u < graph.num_mines; ++u) {
-    std::vector<int> dist, prev;
-    calc_shortest_paths(u, dist, prev);
+  if (cur_dists_calls == 0) {
+    cur_dists_thread = std::this_thread::get_id();
+  }
+  assert(cur_dists_thread == std::this_thread::get_id());
+
+  std::vector<int> dist;
+  if (cur_dists_calls++ == 0) {
+    // most processes only serve one move, for which the BFS is the fastest
+    for (int u = 0; u < graph.num_mines; ++u) {
+      calc_shortest_paths(u, dist, prevs[u]);
+      dists.set_row(u, dist.data());
+    }
+    dists.compact();
+    return;
+  }
 
-    dists.push_back(std::move(dist));
-    prevs.push_back(std::move(prev));
+  std::vector<int> mines(graph.num_mines);
+  for (int u = 0; u < graph.num_mines; ++u) {
+    mines[u] = u;
+  }
+  cur_dists_cache.sync(graph, punter_id, mines);
+  for (int u = 0; u < graph.num_mines; ++u) {
+    cur_dists_cache.copy_row(u, dist, prevs[u], INF);
+    dists.set_row(u, dist.data());
   }
+  dists.compact();
 }
 
 void
 Game::calc_shortest_paths_option(int src, std::vector<std::vector<int>>& dist, std::vector<std::vector<int>>& prev) const {
+  turn_stats::count(turn_stats::BFS);
   const int opt_remain = graph.num_mines - options_bought;
   // initialize
   dist.assign(graph.num_vertices, std::vector<int>(graph.num_mines + 1, INF));
@@ -867,7 +2015,7 @@ Game::calc_shortest_paths_option(int src, std::vector<std::vector<int>>& dist, s
 }
 
 void
-Game::calc_cur_dists_option(std::vector<std::vector<std::vector<int>>>& dists, std::vector<std::vector<std::vector<int>>>& prevs) const {
+Game::calc_cur_dists_option(std::vector<DistanceMatrix>& dists, std::vector<std::vector<std::vector<int>>>& prevs) const {
   dists.clear();
   prevs.clear();
 
@@ -875,18 +2023,23 @@ Game::calc_cur_dists_option(std::vector<std::vector<std::vector<int>>>& dists, s
     std::vector<std::vector<int>> dist, prev;
     calc_shortest_paths_option(u, dist, prev);
 
-    dists.push_back(std::move(dist));
+    dists.emplace_back(dist, INF);
     prevs.push_back(std::move(prev));
   }
 }
 
+void
+Game::set_shortest_distances(const std::vector<std::vector<int>>& distances) {
+  distance_table = DistanceTable(distances);
+}
+
 void
 Game::import(const Game& meta_ai) {
   num_punters = meta_ai.num_punters;
   punter_id = meta_ai.punter_id;
   graph = meta_ai.graph;
   history = meta_ai.history;
-  shortest_distances = meta_ai.shortest_distances;
+  distance_table = meta_ai.distance_table;
   //////////////////////////////  //////////////////////////////
   //////////////////////////////  //////////////////////////////
   info = meta_ai.info_for_import; //////////////////////////////
@@ -897,6 +2050,7 @@ Game::import(const Game& meta_ai) {
   splurges_enabled = meta_ai.splurges_enabled;
   splurge_length = meta_ai.splurge_length;
   first_turn = meta_ai.first_turn;
-  reverse_id_map = meta_ai.reverse_id_map;
   id_map = meta_ai.id_map;
+  map_hash = meta_ai.map_hash;
+  map_cached = meta_ai.map_cached;
 }
@@ -1,10 +1,22 @@
 #pragma once
 
 #include <vector>
+#include <chrono>
+#include <functional>
 #include <cstdint>
 #include <string>
+#include <thread>
 #include <cassert>
 #include "json/json.h"
+#include "Protocol.h"
+#include "IdMap.h"
+#include "DistanceTable.h"
+#include "DistanceMatrix.h"
+#include "CurrentDistances.h"
+
+namespace state_codec {
+class Writer;
+}
 
 namespace json_helper {
 
@@ -13,6 +25,8 @@ void write_json(const Json::Value& json);
 
 }
 
+class EvalWorkspace;
+
 struct Graph {
   struct River {
     int to;
@@ -34,8 +48,11 @@ struct Graph {
   const River& find_river(int src, int to) const;   // return reference of river from |src| to |to|
 
   static Graph from_json(const Json::Value& json);
-  static std::tuple<Graph, std::vector<int>, std::map<int, int>>
+  static std::tuple<Graph, IdMap>
     from_json_setup(const Json::Value& json);
+  static std::tuple<Graph, IdMap>
+    from_setup(const std::vector<int>& sites, const std::vector<int>& mines,
+               const std::vector<protocol::SetupRiver>& rivers);
 
   Json::Value to_json() const;
 
@@ -48,11 +65,95 @@ struct Graph {
     const std::vector<std::vector<int>>& distances,
     int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
     int calc_punter = -1) const;
+  // the same, with the buffers and sorted adjacency of |workspace|; the
+  // overloads above use a workspace of the calling thread
+  std::vector<int64_t> evaluate(
+    EvalWorkspace& workspace, int num_punters,
+    const std::vector<std::vector<int>>& distances, int calc_punter = -1) const;
+  std::vector<int64_t> evaluate(
+    EvalWorkspace& workspace, int num_punters,
+    const std::vector<std::vector<int>>& distances,
+    int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+    int calc_punter = -1) const;
+  // the same on the contiguous tables of Game::get_distance_table()
+  std::vector<int64_t> evaluate(
+    int num_punters, const DistanceTable& table, int calc_punter = -1) const;
+  std::vector<int64_t> evaluate(
+    int num_punters, const DistanceTable& table,
+    int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+    int calc_punter = -1) const;
+  std::vector<int64_t> evaluate(
+    EvalWorkspace& workspace, int num_punters, const DistanceTable& table,
+    int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+    int calc_punter = -1) const;
 
-  std::vector<std::vector<int>> calc_shortest_distances() const;
+  // gains[u][j]: how much evaluate(...)[punter] grows when |punter| takes
+  // rivers[u][j] (a claim, or with |options| also an option on a river
+  // another punter owns); -1 if it cannot take the river.  The punter's
+  // rivers are loaded into an IncrementalScorer once, and every river is
+  // a gain() query on it instead of an evaluate().
+  std::vector<std::vector<int64_t>> marginal_gains(
+    int punter, const DistanceTable& table, bool options = false) const;
+
+  struct BestGain {
+    int src = -1, to = -1;  // -1 if no river increases the score
+    int64_t gain = 0;
+  };
+  // for every punter at once, the free river src < to with the largest
+  // positive marginal gain; ties go to the larger degree of |to|, then to
+  // the first river in (src, to) order.  |allowed| filters the candidates.
+  std::vector<BestGain> best_gains(
+    int num_punters, const DistanceTable& table,
+    const std::function<bool(int, int)>& allowed = nullptr) const;
+
+  // distances[mine][v], 1<<29 if unreachable.  PER_MINE runs one BFS per
+  // mine; BIT_PARALLEL runs one BFS per 64 mines with a bit per mine in
+  // the frontier masks.  AUTO runs the first mine alone and switches to
+  // BIT_PARALLEL when more mines are left than that BFS had levels.
+  enum class DistanceMethod { AUTO, PER_MINE, BIT_PARALLEL };
+  std::vector<std::vector<int>> calc_shortest_distances(
+    DistanceMethod method = DistanceMethod::AUTO) const;
   int64_t evaluate_future(
     int punter_id, const std::vector<int>& futures,
     const std::vector<std::vector<int>>& distances) const;
+
+private:
+  // the body of evaluate() for both kinds of distance tables
+  template<class Distances>
+  std::vector<int64_t> evaluate_with(
+    EvalWorkspace& workspace, int num_punters, const Distances& distances,
+    int my_punter_id, const std::vector<int>& futures, int64_t& future_score,
+    int calc_punter) const;
+};
+
+/*
+ *  Scratch space of Graph::evaluate, sized once per map.
+ *
+ *  Besides the BFS buffers it keeps, for every vertex, its rivers plus one
+ *  entry per bought option sorted by punter, together with the rivers they
+ *  were built from.  Each evaluate() compares the graph with that copy and
+ *  re-sorts only the vertices whose rivers changed, so consecutive calls on
+ *  one graph cost a linear scan instead of a copy and sort of every list.
+ *  Nothing is shared between workspaces: use one per thread.
+ */
+
+class EvalWorkspace {
+  friend struct Graph;
+
+  int num_vertices = -1;
+  std::vector<int> offsets;             // vertex -> first slot, 2 * degree slots each
+  std::vector<int> sizes;               // vertex -> used slots
+  std::vector<Graph::River> sorted;     // rivers and options, sorted by punter
+  std::vector<Graph::River> cached;     // rivers the sorted lists were built from
+  std::vector<int> que;
+  std::vector<int> nxt;
+  std::vector<char> visited;            // all zero between calls, padded for DistanceTable
+  std::vector<char> computed_mine;
+
+  void prepare(const Graph& graph);
+public:
+  // drops the sorted adjacency, e.g. before switching to another map
+  void clear() { num_vertices = -1; }
 };
 
 struct Move {
@@ -102,7 +203,7 @@ protected:
   int punter_id;
   Graph graph;
   History history;
-  std::vector<std::vector<int>> shortest_distances;
+  DistanceTable distance_table;  // the shortest distances, compact and squared
   Json::Value info;
 
   int original_vertex_id(int vertex_id) const;
@@ -119,24 +220,118 @@ protected:
   bool options_enabled;
   int options_bought;
 
-  void calc_shortest_paths(int src, std::vector<int>& dist, std::vector<int>& path) const;
-  void calc_cur_dists(std::vector<std::vector<int>>& dists, std::vector<std::vector<int>>& prevs) const;
+  // dist[v]: rivers to claim between src and v, INF when it can no longer
+  // be reached; prev[v] is the previous vertex on such a path (0-1 BFS)
+  void calc_shortest_paths(int src, std::vector<int>& dist, std::vector<int>& prev) const;
+  // the same from every mine.  The first call of a process runs the BFS;
+  // later calls keep the searches in cur_dists_cache and repair them when
+  // the graph only got more claims since.  The distances are the same
+  // either way, but from the second call on prev[v] follows the rule of
+  // CurrentDistances.h, which can pick another of several cheapest paths
+  // than the BFS.  Only a process that serves several moves (persistent
+  // mode) makes a second call; offline and zygote runs keep the BFS.
+  void calc_cur_dists(DistanceMatrix& dists, std::vector<std::vector<int>>& prevs) const;
   void calc_shortest_paths_option(int src, std::vector<std::vector<int>>& dist, std::vector<std::vector<int>>& prev) const;
-  void calc_cur_dists_option(std::vector<std::vector<std::vector<int>>>& dists, std::vector<std::vector<std::vector<int>>>& prevs) const;
+  // dists[mine][v][options used], rows indexed by v
+  void calc_cur_dists_option(std::vector<DistanceMatrix>& dists, std::vector<std::vector<std::vector<int>>>& prevs) const;
 
   mutable Json::Value info_for_import;
 
+  // state (de)serialization; binary unless PUNTER_STATE_FORMAT=json
+  bool binary_state;
+  // the binary state only refers to the map by its hash (see MapCache.h)
+  bool map_cached;
+  uint64_t map_hash;
+  Json::Value encode_state(const Json::Value& info) const;
+  void write_state(protocol::Writer& out, const Json::Value& info) const;
+  // false when the state is corrupt or refers to a map cache that cannot
+  // be loaded; the game is then only partly decoded
+  bool decode_state(Json::Value state);
+
+  // PUNTER_PERSISTENT=1: one process serves setup, every move and stop of a
+  // game; the state stays in memory and is neither sent nor received
+  bool persistent;
+
+  // process one message and write the reply to |out|
+  void handle_setup(const Json::Value& json, protocol::Writer& out);
+  void handle_move(const Json::Value& json, protocol::Writer& out);
+  void handle_setup(const protocol::SetupMessage& msg, protocol::Writer& out);
+  void handle_move(const protocol::MoveMessage& msg, protocol::Writer& out);
+
 private:
   bool first_turn;
-  std::vector<int> reverse_id_map;
-  std::map<int, int> id_map;
+  IdMap id_map;
+
+  // the searches of the last calc_cur_dists(), from its second call on.
+  // The const calc_cur_dists() writes them without a lock, so it is not
+  // thread-safe: every call must come from the thread of the first one,
+  // which is asserted.
+  mutable CurrentDistances cur_dists_cache;
+  mutable int cur_dists_calls = 0;
+  mutable std::thread::id cur_dists_thread;
+
+  // stores the result of Graph::calc_shortest_distances()
+  void set_shortest_distances(const std::vector<std::vector<int>>& distances);
+
+  // the part of the state a move changes, passed explicitly so that the
+  // watchdog can encode the state after a fallback move (see
+  // fallback_reply()) from a snapshot of the rest
+  struct TurnState {
+    bool first_turn;
+    int splurge_length;
+    int options_bought;
+    bool with_search;  // carried_search() is written
+  };
+  TurnState turn_state() const {
+    return TurnState{first_turn, splurge_length, options_bought, true};
+  }
 
-  Json::Value encode_state(const Json::Value& info) const;
-  void decode_state(Json::Value state);
+  void write_next_state(protocol::Writer& out, const Json::Value& info, const TurnState& turn) const;
+  Json::Value encode_state_json(const Json::Value& info) const;
+  void write_state_json(protocol::Writer& out, const Json::Value& info, const TurnState& turn) const;
+  void decode_state_json(const Json::Value& state);
+  std::string encode_state_binary(const TurnState& turn) const;
+  // encode_state_binary() writes the head, the splurge length and the
+  // options bought, the body, then the search
+  void encode_state_head(state_codec::Writer& w, bool first_turn) const;
+  void encode_state_body(state_codec::Writer& w) const;
+  bool decode_state_binary(const std::string& blob);
 
   void handshake() const;
+  // false on a stop message, which has no reply
+  bool handle_message(const char* payload, size_t length, protocol::Writer& out);
+  // PUNTER_ZYGOTE=<socket path>: fork server, see Zygote.h
+  void run_zygote(const char* path);
+
+  // writes the reply for |move_res|, with |next| the state after it
+  void write_reply(const MoveResult& move_res, protocol::Writer& out, bool with_search, TurnState& next) const;
+  // what the reply for |move_res| says: the key of the move, its vertices
+  // in the ids of the server (source and target, or the route), and the
+  // splurge length and options bought after it in |next|
+  void resolve_move(const MoveResult& move_res, const char*& kind, std::vector<int>& route, TurnState& next) const;
+  // write_reply() and advances the turn counters
+  void finish_move(const MoveResult& move_res, protocol::Writer& out);
+  // a pass for a move message whose state does not decode
+  void reply_undecodable(const protocol::MoveMessage& msg, protocol::Writer& out);
+
+  // turn deadline and watchdog fallback, see deadline() / update_best_move()
+  void set_deadline(int budget_ms, int decode_ms);
+  // takes what fallback_reply() needs of the game, before move() runs
+  void snapshot_fallback();
+  // the reply for the move of the last update_best_move(), without the
+  // search data; called on the watchdog thread while move() still runs,
+  // so it is built from the snapshot and the resolved move only
+  static std::string fallback_reply(TurnState& next, Json::Value& next_info);
+
+  // per-turn instrumentation, see TurnStats.h
+  protocol::MessageType last_message;
+  bool read_message(const char*& payload, size_t& length);
+  void emit_turn_stats() const;
 
 public:
+  Game();
+  virtual ~Game() {}
+
   const std::vector<int>& get_futures() const {
     return futures;
   }
@@ -149,8 +344,12 @@ public:
     return &graph;
   }
 
-  const std::vector<std::vector<int>>& get_shortest_distances() const {
-    return shortest_distances;
+  const DistanceMatrix& get_shortest_distances() const {
+    return distance_table.matrix();
+  }
+
+  const DistanceTable& get_distance_table() const {
+    return distance_table;
   }
 
   int get_punter_id() const {
@@ -177,7 +376,39 @@ public:
     return options_enabled && options_bought < graph.num_mines;
   }
 
+  bool is_persistent() const {
+    return persistent;
+  }
+
+  // Search data an AI carries from one move to the next (see MCTS_core.h);
+  // Game does not look into it.  It is part of the offline state, and in
+  // persistent mode it simply stays in memory.  Decoding a state replaces it.
+  static std::string& carried_search();
+
+  // When setup() / move() should return: PUNTER_SETUP_BUDGET_MS (10000) or
+  // PUNTER_MOVE_BUDGET_MS (1000) after the turn started, minus
+  // PUNTER_RESERVE_MS (50) and the time the state took to decode.
+  std::chrono::steady_clock::time_point deadline() const;
+  int remaining_ms() const;
+  // also true once the watchdog has sent the fallback of the turn
+  bool time_is_up() const;
+
+  // Anytime contract: registers the best move found so far.  If move() is
+  // still running at the end of the budget, a watchdog sends this move (a
+  // pass until the first call) and ends the turn; PUNTER_WATCHDOG=0
+  // disables it.  A null info keeps the info of the previous turn.  A call
+  // only resolves the move against the game (see move()); the state is
+  // encoded before move(), and the reply, whose state carries no search
+  // data (see carried_search()), is put together when the watchdog fires.
+  // In persistent mode the late result of move() is dropped, and the wait
+  // for it counts against the next turn.
+  void update_best_move(const MoveResult& move) const;
+
   virtual SetupSettings setup() const = 0;
+  // Must not change the state the game shares with Game (graph, history,
+  // futures, info, ...): search threads and update_best_move() read it
+  // while move() runs, and the watchdog replies from a snapshot taken
+  // before the call.  Search on copies instead.
   virtual MoveResult move() const = 0;
   virtual Json::Value walkin_setup() const { assert(false); };
 
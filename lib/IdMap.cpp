@@ -0,0 +1,57 @@
+#include "IdMap.h"
+
+#include <algorithm>
+
+namespace {
+
+// site ids spanning at most this many times the number of sites are
+// looked up through the flat table
+const int DENSE_SPAN_FACTOR = 4;
+
+}
+
+IdMap::IdMap(std::vector<int> originals)
+  : originals(std::move(originals)), base(0) {
+  build_index();
+}
+
+void
+IdMap::build_index() {
+  dense.clear();
+  sorted.clear();
+  base = 0;
+  if (originals.empty()) {
+    return;
+  }
+
+  const auto range = std::minmax_element(originals.begin(), originals.end());
+  const long long span = (long long)*range.second - *range.first + 1;
+  if (span <= DENSE_SPAN_FACTOR * (long long)originals.size() + 64) {
+    base = *range.first;
+    dense.assign(span, -1);
+    for (int v = 0; v < (int)originals.size(); ++v) {
+      dense[originals[v] - base] = v;
+    }
+    return;
+  }
+
+  sorted.reserve(originals.size());
+  for (int v = 0; v < (int)originals.size(); ++v) {
+    sorted.emplace_back(originals[v], v);
+  }
+  std::sort(sorted.begin(), sorted.end());
+}
+
+int
+IdMap::find_sorted(int site_id) const {
+  auto it = std::lower_bound(sorted.begin(), sorted.end(), std::make_pair(site_id, -1));
+  return it != sorted.end() && it->first == site_id ? it->second : -1;
+}
+
+void
+IdMap::clear() {
+  originals.clear();
+  dense.clear();
+  sorted.clear();
+  base = 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+
+/*
+ *  Translation between the site ids of the protocol and the dense vertex
+ *  ids of Graph (mines first, then the other sites in input order).
+ *
+ *  Built once from the vertex -> site id table.  Site ids that are
+ *  already compact (the common case) are looked up in a flat offset
+ *  table; otherwise a sorted array of (site id, vertex) pairs is
+ *  binary-searched.
+ */
+
+class IdMap {
+  std::vector<int> originals;  // vertex -> site id
+  int base;                    // smallest site id (dense mode)
+  std::vector<int> dense;      // site id - base -> vertex, -1 if unused
+  std::vector<std::pair<int, int>> sorted;  // (site id, vertex), sparse mode
+
+  void build_index();
+public:
+  IdMap() : base(0) {}
+  explicit IdMap(std::vector<int> originals);
+
+  // vertex id of |site_id|, -1 if the site is unknown
+  int operator[](int site_id) const {
+    if (!sorted.empty()) {
+      return find_sorted(site_id);
+    }
+    const unsigned off = (unsigned)(site_id - base);
+    return off < dense.size() ? dense[off] : -1;
+  }
+  int find_sorted(int site_id) const;
+
+  // site id of |vertex|
+  int original(int vertex) const { return originals[vertex]; }
+  const std::vector<int>& vertices() const { return originals; }
+
+  int size() const { return originals.size(); }
+  bool empty() const { return originals.empty(); }
+  bool is_dense() const { return sorted.empty(); }
+  void clear();
+};
@@ -0,0 +1,295 @@
+#include "IncrementalScorer.h"
+#include "TurnStats.h"
+
+#include <cassert>
+#include <algorithm>
+
+IncrementalScorer::IncrementalScorer(int num_punters, const DistanceTable& table)
+  : table(&table), num_punters(num_punters),
+    num_vertices(table.vertices()), num_mines(table.mines()),
+    nodes((size_t)num_punters * num_vertices),
+    first_mine((size_t)num_punters * num_vertices, -1),
+    sum_index((size_t)num_punters * num_vertices, -1),
+    next_mine((size_t)num_punters * num_mines),
+    punter_scores(num_punters, 0) {
+  for (int p = 0; p < num_punters; ++p) {
+    const size_t base = (size_t)p * num_vertices;
+    for (int v = 0; v < num_vertices; ++v) {
+      nodes[base + v] = Node{-1, v};
+    }
+    for (int m = 0; m < num_mines; ++m) {
+      first_mine[base + m] = m;
+      next_mine[(size_t)p * num_mines + m] = m;
+    }
+  }
+}
+
+void
+IncrementalScorer::load(const Graph& graph) {
+  for (int u = 0; u < graph.num_vertices; ++u) {
+    for (const auto& river : graph.rivers[u]) {
+      if (u > river.to) continue;
+      if (river.punter != -1) claim(u, river.to, river.punter);
+      if (river.option != -1) option(u, river.to, river.option);
+    }
+  }
+  log.clear();
+}
+
+void
+IncrementalScorer::load(const Graph& graph, int punter) {
+  assert(num_punters == 1);
+  for (int u = 0; u < graph.num_vertices; ++u) {
+    for (const auto& river : graph.rivers[u]) {
+      if (u < river.to && (river.punter == punter || river.option == punter)) {
+        claim(u, river.to, 0);
+      }
+    }
+  }
+  log.clear();
+}
+
+void
+IncrementalScorer::load(const CsrGraph& graph, const OwnershipTable& own) {
+  loaded = own;
+  free_edges.clear();
+  for (int e = 0; e < graph.num_edges; ++e) {
+    const int u = graph.edge_source(e), v = graph.edge_target(e);
+    if (own.punter(e) != -1) claim(u, v, own.punter(e));
+    if (own.option(e) != -1) option(u, v, own.option(e));
+    if (own.punter(e) == -1 || own.option(e) == -1) {
+      free_edges.push_back(FreeEdge{e, u, v});
+    }
+  }
+  log.clear();
+  loaded_nodes = nodes;
+  que.resize(num_vertices);
+  visited.assign(DistanceTable::padded_size(num_vertices), 0);
+  computed_mine.resize(num_mines);
+}
+
+int
+IncrementalScorer::find(int base, int v) const {
+  while (nodes[base + v].parent >= 0) {
+    v = nodes[base + v].parent;
+  }
+  return v;
+}
+
+int64_t
+IncrementalScorer::merge_gain(int punter, int a, int b) const {
+  // each side gains the other side's dist^2 sums for its own mines
+  const int base = punter * num_vertices;
+  const int* next = &next_mine[(size_t)punter * num_mines];
+  int64_t delta = 0;
+  const int mine_a = first_mine[base + a], mine_b = first_mine[base + b];
+  if (mine_a >= 0) {
+    int m = mine_a;
+    do {
+      delta += comp_sum(base, b, m);
+      m = next[m];
+    } while (m != mine_a);
+  }
+  if (mine_b >= 0) {
+    int m = mine_b;
+    do {
+      delta += comp_sum(base, a, m);
+      m = next[m];
+    } while (m != mine_b);
+  }
+  return delta;
+}
+
+void
+IncrementalScorer::claim(int u, int v, int punter) {
+  const int base = punter * num_vertices;
+  int child = find(base, u);
+  int root = find(base, v);
+  if (child == root) {
+    log.push_back(Change{punter, -1, -1, 0, false, 0});
+    return;
+  }
+  Node* n = &nodes[base];
+  if (n[child].parent < n[root].parent) {
+    std::swap(child, root);  // |root| is the larger one
+  }
+  const int64_t delta = merge_gain(punter, child, root);
+
+  const bool new_row = sum_index[base + root] < 0;
+  if (new_row) {
+    sum_index[base + root] = sums.size() / (num_mines ? num_mines : 1);
+    for (int m = 0; m < num_mines; ++m) {
+      sums.push_back(table->square(m, root));
+    }
+  }
+  int64_t* root_sums = &sums[(size_t)sum_index[base + root] * num_mines];
+  for (int m = 0; m < num_mines; ++m) {
+    root_sums[m] += comp_sum(base, child, m);
+  }
+
+  // splicing two cycles gives one cycle through both
+  std::swap(n[child].next, n[root].next);
+  const int child_mine = first_mine[base + child];
+  int& root_mine = first_mine[base + root];
+  if (child_mine >= 0 && root_mine >= 0) {
+    int* next = &next_mine[(size_t)punter * num_mines];
+    std::swap(next[child_mine], next[root_mine]);
+  } else if (root_mine < 0) {
+    root_mine = child_mine;
+  }
+  const int child_size = -n[child].parent;
+  n[root].parent -= child_size;
+  n[child].parent = root;
+  punter_scores[punter] += delta;
+  log.push_back(Change{punter, child, root, child_size, new_row, delta});
+}
+
+void
+IncrementalScorer::undo() {
+  assert(!log.empty());
+  const Change c = log.back();
+  log.pop_back();
+  if (c.child < 0) {
+    return;
+  }
+
+  const int base = c.punter * num_vertices;
+  Node* n = &nodes[base];
+  n[c.child].parent = -c.child_size;
+  n[c.root].parent += c.child_size;
+  std::swap(n[c.child].next, n[c.root].next);
+  const int child_mine = first_mine[base + c.child];
+  int& root_mine = first_mine[base + c.root];
+  if (root_mine == child_mine) {
+    root_mine = -1;  // the mines came with |child|, or there are none
+  } else if (child_mine >= 0) {
+    int* next = &next_mine[(size_t)c.punter * num_mines];
+    std::swap(next[child_mine], next[root_mine]);
+  }
+  if (c.new_row) {
+    // rows are allocated and released in LIFO order
+    sums.resize(sums.size() - num_mines);
+    sum_index[base + c.root] = -1;
+  } else {
+    int64_t* root_sums = &sums[(size_t)sum_index[base + c.root] * num_mines];
+    for (int m = 0; m < num_mines; ++m) {
+      root_sums[m] -= comp_sum(base, c.child, m);
+    }
+  }
+  punter_scores[c.punter] -= c.delta;
+}
+
+void
+IncrementalScorer::undo_to(size_t mark) {
+  while (log.size() > mark) {
+    undo();
+  }
+}
+
+bool
+IncrementalScorer::connected(int punter, int u, int v) const {
+  const int base = punter * num_vertices;
+  return find(base, u) == find(base, v);
+}
+
+int64_t
+IncrementalScorer::gain(int punter, int u, int v) const {
+  const int base = punter * num_vertices;
+  const int a = find(base, u);
+  const int b = find(base, v);
+  return a == b ? 0 : merge_gain(punter, a, b);
+}
+
+int64_t
+IncrementalScorer::future_score(int punter, const std::vector<int>& futures) const {
+  int64_t res = 0;
+  for (int m = 0; m < num_mines; ++m) {
+    if (futures[m] < 0) continue;
+    const int64_t dis = table->distance(m, futures[m]);
+    res += (connected(punter, m, futures[m]) ? +1 : -1) * dis * dis * dis;
+  }
+  return res;
+}
+
+void
+IncrementalScorer::join(int punter, int u, int v) {
+  Node* n = &nodes[(size_t)punter * num_vertices];
+  // path halving; the forest is copied back afterwards, so nothing has
+  // to be undone
+  auto find = [n](int v) {
+    while (n[v].parent >= 0) {
+      const int up = n[v].parent;
+      if (n[up].parent < 0) {
+        return up;
+      }
+      n[v].parent = n[up].parent;
+      v = n[up].parent;
+    }
+    return v;
+  };
+  u = find(u);
+  v = find(v);
+  if (u == v) {
+    return;
+  }
+  if (n[u].parent > n[v].parent) {
+    std::swap(u, v);
+  }
+  n[u].parent += n[v].parent;
+  n[v].parent = u;
+  std::swap(n[u].next, n[v].next);
+}
+
+std::vector<int64_t>
+IncrementalScorer::playout(const OwnershipTable& own, int my_punter_id,
+                           const std::vector<int>& futures, int64_t& future_score) {
+  assert(log.empty());
+  turn_stats::count(turn_stats::EVALUATE);
+  for (const FreeEdge& f : free_edges) {
+    if (own.punter(f.e) != loaded.punter(f.e)) {
+      join(own.punter(f.e), f.u, f.v);
+    }
+    if (own.option(f.e) != loaded.option(f.e)) {
+      join(own.option(f.e), f.u, f.v);
+    }
+  }
+
+  // the roots' mines and sums are those of the loaded forest, so the
+  // components are walked as in Graph::evaluate
+  std::vector<int64_t> scores(num_punters, 0LL);
+  future_score = 0;
+  for (int punter = 0; punter < num_punters; ++punter) {
+    const Node* n = &nodes[(size_t)punter * num_vertices];
+    std::fill(computed_mine.begin(), computed_mine.end(), 0);
+    for (int mine = 0; mine < num_mines; ++mine) {
+      if (computed_mine[mine]) continue;
+
+      // the component of |mine|, as a list and as a mask
+      int reach_cnt = 0;
+      int v = mine;
+      do {
+        que[reach_cnt++] = v;
+        visited[v] = 1;
+        v = n[v].next;
+      } while (v != mine);
+
+      for (int tmine = mine; tmine < num_mines; ++tmine) {
+        if (computed_mine[tmine] || !visited[tmine]) continue;
+
+        computed_mine[tmine] = true;
+        if (punter == my_punter_id && futures[tmine] >= 0) {
+          const int64_t dis = table->distance(tmine, futures[tmine]);
+          future_score += (visited[futures[tmine]] ? +1 : -1) * dis * dis * dis;
+        }
+        scores[punter] += table->sum(tmine, que.data(), reach_cnt, visited.data());
+      }
+
+      for (int i = 0; i < reach_cnt; ++i) {
+        visited[que[i]] = 0;
+      }
+    }
+  }
+
+  std::copy(loaded_nodes.begin(), loaded_nodes.end(), nodes.begin());
+  return scores;
+}
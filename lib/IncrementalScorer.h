@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "Game.h"
+#include "DistanceTable.h"
+#include "CsrGraph.h"
+
+/*
+ *  Stateful counterpart of Graph::evaluate.
+ *
+ *  Every punter has a union-find over the vertices (union by size, no path
+ *  compression, so that every union can be undone).  The vertices of a
+ *  component are linked in a cycle, and so are its mines.  A component
+ *  root keeps one of its mines and, for every mine m, the sum of
+ *  dist(m, v)^2 over its vertices; the punter's score is the sum over the
+ *  components of the entries of their own mines.  claim() / option() merge
+ *  two components in O(M) and undo() reverts the latest one, so trying a
+ *  move costs O(M a(V)) instead of a BFS from every mine.
+ *
+ *  playout() scores a whole random playout instead: it joins the rivers
+ *  given away with path halving and without the sums, sums the squares
+ *  over the vertex cycles of the components with a mine, as
+ *  Graph::evaluate does over its BFS, and copies the loaded forest back.
+ *
+ *  The squares come from the DistanceTable, which must outlive the scorer.
+ */
+
+class IncrementalScorer {
+  const DistanceTable* table = nullptr;
+  int num_punters = 0;
+  int num_vertices = 0;
+  int num_mines = 0;
+
+  // per punter, indexed by punter * num_vertices + v
+  struct Node {
+    int parent;  // minus the size of the component at a root
+    int next;    // the next vertex of the component
+  };
+  std::vector<Node> nodes;
+  std::vector<int> first_mine;  // a mine of the component at a root, or -1
+  std::vector<int> sum_index;   // row in |sums|, -1 for a singleton
+  // per punter, indexed by punter * num_mines + m: the next mine of the
+  // component of m
+  std::vector<int> next_mine;
+
+  std::vector<int64_t> sums;    // rows of num_mines entries
+  std::vector<int64_t> punter_scores;
+
+  struct Change {
+    int punter;
+    int child;       // root attached under |root|, -1 if nothing was merged
+    int root;
+    int child_size;
+    bool new_row;    // |root| got its row in |sums| by this change
+    int64_t delta;
+  };
+  std::vector<Change> log;
+
+  // what playout() starts from: the forest of load(const CsrGraph&, ...)
+  // and the rivers without a punter or an option there
+  struct FreeEdge {
+    int e;
+    int u, v;
+  };
+  std::vector<FreeEdge> free_edges;
+  OwnershipTable loaded;
+  std::vector<Node> loaded_nodes;
+  // scratch of playout()
+  std::vector<int> que;
+  std::vector<char> visited, computed_mine;
+
+  int find(int base, int v) const;
+  int64_t comp_sum(int base, int root, int mine) const {
+    const int row = sum_index[base + root];
+    return row < 0 ? table->square(mine, root) : sums[(size_t)row * num_mines + mine];
+  }
+  // the score |punter| gains by merging the components of the roots |a| and |b|
+  int64_t merge_gain(int punter, int a, int b) const;
+  // joins the components of u and v of |punter| in playout()
+  void join(int punter, int u, int v);
+public:
+  IncrementalScorer() {}
+  // every river free
+  IncrementalScorer(int num_punters, const DistanceTable& table);
+
+  // replays every claimed river and bought option of |graph|; the log is
+  // cleared afterwards
+  void load(const Graph& graph);
+  // the same for the rivers |punter| claimed or holds an option on, which
+  // become those of punter 0 of a scorer of one punter
+  void load(const Graph& graph, int punter);
+  // the same for |own| on |graph|; playout() then scores the tables that
+  // only add punters and options to |own|
+  void load(const CsrGraph& graph, const OwnershipTable& own);
+
+  // gives the river u - v to |punter|; an option counts the same for the score
+  void claim(int u, int v, int punter);
+  void option(int u, int v, int punter) { claim(u, v, punter); }
+  // reverts the latest claim() / option()
+  void undo();
+  // reverts every claim() / option() after |mark| = history_size()
+  size_t history_size() const { return log.size(); }
+  void undo_to(size_t mark);
+
+  int64_t score(int punter) const { return punter_scores[punter]; }
+  const std::vector<int64_t>& scores() const { return punter_scores; }
+  bool connected(int punter, int u, int v) const;
+  // the score claim(u, v, punter) would add, without claiming
+  int64_t gain(int punter, int u, int v) const;
+  // the futures part of Graph::evaluate for |punter|
+  int64_t future_score(int punter, const std::vector<int>& futures) const;
+
+  // the same as graph.evaluate(own, num_punters, table, my_punter_id,
+  // futures, future_score) on the graph of load(const CsrGraph&, ...),
+  // without a claim() since.  The rivers |own| gives away are joined in
+  // edge order, which keeps the union-find in cache.
+  std::vector<int64_t> playout(const OwnershipTable& own, int my_punter_id,
+                               const std::vector<int>& futures, int64_t& future_score);
+};
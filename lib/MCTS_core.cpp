@@ -1,104 +1,61 @@
 #include "MCTS_core.h"
+#include "ThreadPool.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <chrono>
 #include <set>
 #include <cassert>
 #include <cmath>
+#include <climits>
 #include <queue>
+#include <new>
 
 namespace {
 
-  void apply_move(Graph &cur_state, move_t move, int cur_player, vector<int> &remaining_options) {
-    /* apply "move" to "cur_state" */
-    for(auto& r : cur_state.rivers[move.first]) {
-      if (r.to == move.second) {
-	if (r.punter != -1) {
-	  assert(r.option == -1);
-	  r.option = cur_player;
-	  assert(remaining_options[cur_player] > 0);
-	  remaining_options[cur_player] -= 1;
-	} else {
-	  r.punter = cur_player;
-	}
-      }
-    }
-    for(auto& r : cur_state.rivers[move.second]) {
-      if (r.to == move.first) {
-	if (r.punter != -1) {
-	  assert(r.option == -1);
-	  r.option = cur_player;
-	} else {
-	  r.punter = cur_player;
-	}
-      }
+  void apply_move(OwnershipTable &cur_state, int edge, int cur_player, vector<int> &remaining_options) {
+    /* apply the claim of "edge" to "cur_state" */
+    if (cur_state.punter(edge) != -1) {
+      assert(cur_state.option(edge) == -1);
+      cur_state.set_option(edge, cur_player);
+      assert(remaining_options[cur_player] > 0);
+      remaining_options[cur_player] -= 1;
+    } else {
+      cur_state.set_punter(edge, cur_player);
     }
   }
 
-  set<int> get_visited_sites(const Game *game, const vector<Node*> visited_nodes, int punter) {
-    set<int> vertices;
-    const History &history = game->get_history();
-    for (const auto &move: history) {
-      if (move.punter == punter) {
-	vertices.insert(move.to);
-	vertices.insert(move.src);
-      }
-    }
+  size_t align(size_t bytes) {
+    return (bytes + 15) & ~(size_t)15;
+  }
+}
 
-    for (const auto &node: visited_nodes) {
-      if (node->cur_player == punter) {
-	vertices.insert(node->from);
-	vertices.insert(node->to);
-      }
-    }
-    return vertices;
-  }
-
-  move_t get_next_greedy(const Game *game, Graph &graph, const set<int> &visited_sites, int punter) {
-    int src = -1, to = -1;
-    pair<int, int> best_data(-1e9, -1); // pair of a next score and degree of a next vertex
-    for (int v = 0; v < graph.num_vertices; v++) {
-      for (auto &r : graph.rivers[v]) {
-	auto nv = r.to;
-	if (v > nv) {
-	  continue;
-	}
-	if (r.punter != -1) {
-	  continue;
-	}
-
-	const int v_visited = visited_sites.count(v);
-	const int nv_visited = visited_sites.count(nv);
-
-	if (v >= graph.num_mines && nv >= graph.num_mines && !v_visited && !nv_visited) {
-	  continue;
-
-	}
-
-	Graph::River* nrit = nullptr;
-	for (auto &nr : graph.rivers[nv]) {
-	  if (nr.to == v) {
-	    nrit = &nr;
-	    break;
-	  }
-	}
-
-	assert(nrit != nullptr && nrit -> punter == -1);
-	r.punter = punter;
-	nrit->punter = punter;
-	const auto& next_point = graph.evaluate(game->get_num_punters(), game->get_shortest_distances())[punter];
-	pair<int, int> current_data(next_point, graph.rivers[nv].size());
-	if (current_data > best_data) {
-	  best_data = current_data;
-	  src = v;
-	  to = nv;
-	}
-	r.punter = -1;
-	nrit->punter = -1;
-      }
-    }
-    return move_t(src, to);   
+const size_t Arena::CHUNK_BYTES;
+
+void *Arena::allocate(size_t bytes) {
+  bytes = align(bytes);
+  if (used + bytes > CHUNK_BYTES || chunks.empty()) {
+    chunks.emplace_back(new char[max(bytes, CHUNK_BYTES)]);
+    used = 0;
+  }
+  void *p = chunks.back().get() + used;
+  used += bytes;
+  total += bytes;
+  return p;
+}
+
+MCTS_Core::MCTS_Core(Game *parent, const double epsilon)
+  : num_threads(ThreadPool::shared().size()), parallelism(TREE), use_playout_scorer(false),
+    parent(parent), epsilon(epsilon), max_score(1.0) {
+  const char *mode = getenv("PUNTER_MCTS_PARALLEL");
+  if (mode && string(mode) == "root") {
+    parallelism = ROOT;
+  }
+  const char *keep = getenv("PUNTER_MCTS_KEEP");
+  keep_nodes = keep ? atoi(keep) : 512;
+  if (keep_nodes > 0 && parent->is_persistent()) {
+    keep_nodes = INT_MAX;
   }
 }
 
@@ -123,6 +80,63 @@ void MCTS_Core::calc_connected_mine() {
   }
 }
 
+namespace {
+  /* f(block, i) for every published child, in order */
+  template<class F>
+  void for_each_child(const Children &children, F f) {
+    const int size = children.size.load(memory_order_acquire);
+    for (int b = 0; Children::block_start(b) < size; b++) {
+      const ChildBlock *block = children.blocks[b].load(memory_order_acquire);
+      const int n = min(Children::block_capacity(b), size - Children::block_start(b));
+      for (int i = 0; i < n; i++) {
+	f(block, i);
+      }
+    }
+  }
+}
+
+Children *MCTS_Core::new_children(Arena &arena, int cur_player, int target) const {
+  return new (arena.allocate(sizeof(Children))) Children(cur_player, target);
+}
+
+Node MCTS_Core::add_child(Arena &arena, Children &children, int move, int n_plays) const {
+  /* only one thread adds to |children| at a time */
+  const int j = children.size.load(memory_order_relaxed);
+  int b = 0;
+  while (Children::block_start(b + 1) <= j) b++;
+  assert(b < Children::NUM_BLOCKS);
+  ChildBlock *block = children.blocks[b].load(memory_order_relaxed);
+  if (block == nullptr) {
+    const int capacity = Children::block_capacity(b);
+    const size_t header = align(sizeof(ChildBlock));
+    const size_t wide = align(capacity * sizeof(atomic<int64_t>));
+    const size_t ptrs = align(capacity * sizeof(atomic<Children*>));
+    const size_t narrow = align(capacity * sizeof(atomic<int>));
+    char *p = static_cast<char*>(arena.allocate(header + wide + ptrs + narrow + capacity * sizeof(int)));
+    block = new (p) ChildBlock();
+    block->payoffs = reinterpret_cast<atomic<int64_t>*>(p + header);
+    block->next = reinterpret_cast<atomic<Children*>*>(p + header + wide);
+    block->n_plays = reinterpret_cast<atomic<int>*>(p + header + wide + ptrs);
+    block->moves = reinterpret_cast<int*>(p + header + wide + ptrs + narrow);
+    children.blocks[b].store(block, memory_order_release);
+  }
+  const int i = j - Children::block_start(b);
+  new (&block->payoffs[i]) atomic<int64_t>(0);
+  new (&block->next[i]) atomic<Children*>(nullptr);
+  new (&block->n_plays[i]) atomic<int>(n_plays);
+  block->moves[i] = move;
+  children.size.store(j + 1, memory_order_release);
+  return Node{&block->n_plays[i], &block->payoffs[i], &block->next[i], children.cur_player, move};
+}
+
+void MCTS_Core::reset_root() {
+  root.n_plays = 0;
+  root.children = nullptr;
+  for (auto &worker : workers) {
+    worker.arena.clear();
+  }
+}
+
 pair<int, int> MCTS_Core::get_play(int timelimit_ms) {
   for (int i = 0; i < MAX_LOG; ++i) {
     log_memo[i] = log(i * 1.0);
@@ -131,36 +145,58 @@ pair<int, int> MCTS_Core::get_play(int timelimit_ms) {
   backup_graph();
   calc_maybe_unused_edge();
   calc_connected_mine();
+  const int reused_plays = restore_tree() ? root.n_plays.load() : 0;
 
   for(auto a : parent->get_futures()) {
     cerr << a << " ";
   } cerr << endl;
 
   auto start_time = chrono::system_clock::now();
-  int n_simulated = 0;
+  atomic<int> n_simulated(0);
   const vector<int> &futures = parent->get_futures();
+  choose_scorer(futures);
 
-  run_simulation(&root, futures);
+  run_simulation(root.node(), futures, workers[0]);
   ++n_simulated;
   auto one_time = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now() - start_time).count();
 
-  for (;;) {
-    auto elapsed_time = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now() - start_time).count();
-    if (elapsed_time + one_time + 50 >= timelimit_ms) break;
-    run_simulation(&root, futures);
-    n_simulated += 1;
-  }
+  /* in ROOT mode, worker w > 0 grows trees[w] and worker 0 the root */
+  vector<Tree> trees(num_threads);
+
+  // anytime contract: keep the watchdog's fallback at the current best child
+  const int REGISTER_INTERVAL_MS = 100;
+  long long last_registered = -REGISTER_INTERVAL_MS;
+  ThreadPool::shared().parallel_for(num_threads, [&](int w, int thread) {
+    Tree &tree = parallelism == ROOT && w > 0 ? trees[w] : root;
+    for (;;) {
+      auto elapsed_time = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now() - start_time).count();
+      if (elapsed_time + one_time + 50 >= timelimit_ms) break;
+      if (thread == 0 && elapsed_time - last_registered >= REGISTER_INTERVAL_MS) {
+        /* from the calling thread only; in ROOT mode over every tree, as
+           the final pick is */
+        const move_t best = parallelism == ROOT ? best_summed_child(trees) : best_child(root);
+        parent->update_best_move(MoveResult(make_tuple(best.first, best.second, Json::Value())));
+        last_registered = elapsed_time;
+      }
+      run_simulation(tree.node(), futures, workers[w]);
+      n_simulated += 1;
+    }
+  });
+
+  /* the root children summed over the trees */
+  map<int, pair<int, int64_t>> stats;
+  sum_roots(trees, stats);
 
   vector<tuple<double, int, int>> candidates;
   cerr << "----" << endl;
-  for(const auto &p : root.children) {
-    Node *child = p.second.get();
-    double e_payoff = child->payoffs[parent->get_punter_id()] * 1.0 / max(child->n_plays, 1);
-    cerr << child->from << " -> " << child->to << " : E[payoff] = " << e_payoff << " (played " << child->n_plays << " times)"<< endl;
-    candidates.emplace_back(e_payoff, child->from, child->to);
+  for(const auto &p : stats) {
+    const int from = topology.edge_source(p.first), to = topology.edge_target(p.first);
+    double e_payoff = p.second.second * 1.0 / max(p.second.first, 1);
+    cerr << from << " -> " << to << " : E[payoff] = " << e_payoff << " (played " << p.second.first << " times)"<< endl;
+    candidates.emplace_back(e_payoff, from, to);
   }
   sort(candidates.rbegin(), candidates.rend());
-  auto scores = parent->get_graph().evaluate(parent->get_num_punters(), parent->get_shortest_distances());
+  auto scores = parent->get_graph().evaluate(parent->get_num_punters(), parent->get_distance_table());
   cerr << "Punter: " << parent->get_punter_id() << endl;
   for(auto p : scores) {
     cerr << p << " ";
@@ -168,214 +204,490 @@ pair<int, int> MCTS_Core::get_play(int timelimit_ms) {
   cerr << endl;
 
   auto elapsed_time = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now() - start_time).count();
+  long long selections = 0;
+  size_t tree_bytes = 0;
+  for (const auto &worker : workers) {
+    selections += worker.selections;
+    tree_bytes += worker.arena.bytes();
+  }
   cerr << "Elapsed time: " << elapsed_time << " msec" << endl;
-  cerr << "Simulated " << n_simulated << " times" << endl;
-
+  cerr << "Simulated " << n_simulated << " times (" << n_simulated * 1000.0 / max<long long>(elapsed_time, 1) << " playouts/s, "
+       << num_threads << " threads, " << (parallelism == ROOT ? "root" : "tree") << "-parallel, "
+       << (use_playout_scorer ? "union-find" : "evaluate") << ")" << endl;
+  cerr << "Tree: " << selections * 1000.0 / max<long long>(elapsed_time, 1) << " selections/s, "
+       << tree_bytes / 1024 << " KB (" << tree_bytes * 1.0 / max(n_simulated.load(), 1) << " bytes/node)" << endl;
+  cerr << "Root: " << root.n_plays << " plays (" << reused_plays << " reused)" << endl;
+
+  save_tree();
+  reset_root();
   return make_pair(get<1>(candidates[0]), get<2>(candidates[0]));
 }
 
-void MCTS_Core::backup_graph() {
-  const Graph& cur_state = parent->get_graph();
-  const int total_edges = cur_state.num_edges;
-  punter_back = punter_back_array;
-  if (total_edges * 4 > MAX_EDGES) {
-    punter_back_deleter.reset(new int[total_edges * 4]);
-    punter_back = punter_back_deleter.get();
-  }
-
-  {
-    int* p = punter_back;
-    for (const auto& river : cur_state.rivers) {
-      for (const auto& r : river) {
-	*p = r.punter;
-	++p;
-	*p = r.option;
-	++p;
+move_t MCTS_Core::best_play() const {
+  return best_child(root);
+}
+
+move_t MCTS_Core::best_child(const Tree &tree) const {
+  double best_payoff = -1e100;
+  move_t best(-1, -1);
+  const Children *children = tree.children.load(memory_order_acquire);
+  if (children == nullptr) {
+    return best;
+  }
+  for_each_child(*children, [&](const ChildBlock *block, int i) {
+    const int n_plays = block->n_plays[i].load(memory_order_relaxed);
+    const double e_payoff = block->payoffs[i].load(memory_order_relaxed) * 1.0 / max(n_plays, 1);
+    if (e_payoff > best_payoff) {
+      best_payoff = e_payoff;
+      best = make_pair(topology.edge_source(block->moves[i]), topology.edge_target(block->moves[i]));
+    }
+  });
+  return best;
+}
+
+void MCTS_Core::sum_root(const Tree &tree, map<int, pair<int, int64_t>> &stats) const {
+  const Children *children = tree.children.load(memory_order_acquire);
+  if (children == nullptr) {
+    return;
+  }
+  for_each_child(*children, [&](const ChildBlock *block, int i) {
+    pair<int, int64_t> &sum = stats[block->moves[i]];
+    sum.first += block->n_plays[i];
+    sum.second += block->payoffs[i];
+  });
+}
+
+void MCTS_Core::sum_roots(const vector<Tree> &trees, map<int, pair<int, int64_t>> &stats) const {
+  sum_root(root, stats);
+  if (parallelism == ROOT) {
+    for (int w = 1; w < num_threads; w++) {
+      sum_root(trees[w], stats);
+    }
+  }
+}
+
+move_t MCTS_Core::best_summed_child(const vector<Tree> &trees) const {
+  map<int, pair<int, int64_t>> stats;
+  sum_roots(trees, stats);
+  /* the order of the candidates of get_play */
+  tuple<double, int, int> best(-1e100, -1, -1);
+  for (const auto &p : stats) {
+    const double e_payoff = p.second.second * 1.0 / max(p.second.first, 1);
+    best = max(best, make_tuple(e_payoff, topology.edge_source(p.first), topology.edge_target(p.first)));
+  }
+  return make_pair(get<1>(best), get<2>(best));
+}
+
+void MCTS_Core::raise_max_score(double score) {
+  double current = max_score.load(memory_order_relaxed);
+  while (current < score && !max_score.compare_exchange_weak(current, score, memory_order_relaxed)) {
+  }
+}
+
+/*
+ *  Tree reuse
+ */
+
+/* carried_search():
+     num_edges, history size, max_score, maybe_unused_edge,
+     root n_plays, has children, children
+   children: cur_player, cursor, complete, size, then for each child
+     move, n_plays, payoff (zigzag), has children, children */
+void MCTS_Core::save_tree() const {
+  string &carried = Game::carried_search();
+  carried.clear();
+  const Children *top = root.children.load(memory_order_acquire);
+  if (keep_nodes <= 0 || top == nullptr) {
+    return;
+  }
+
+  /* the groups of children under the most played nodes first */
+  set<const Children*> kept;
+  priority_queue<pair<int, const Children*>> que;
+  que.emplace(root.n_plays.load(), top);
+  long long num_kept = 0;
+  while (!que.empty()) {
+    const Children *children = que.top().second;
+    que.pop();
+    const int size = children->size.load(memory_order_acquire);
+    if (num_kept + size > keep_nodes) continue;
+    num_kept += size;
+    kept.insert(children);
+    for_each_child(*children, [&](const ChildBlock *block, int i) {
+      const Children *next = block->next[i].load(memory_order_acquire);
+      if (next != nullptr) que.emplace(block->n_plays[i].load(), next);
+    });
+  }
+
+  state_codec::Writer out;
+  out.put_varint(topology.num_edges);
+  out.put_varint(parent->get_history().size());
+  out.put_varint(llround(max_score.load()));
+  out.put_varint(maybe_unused_edge.size());
+  for (const int e : maybe_unused_edge) {
+    out.put_varint(e);
+  }
+  out.put_varint(root.n_plays.load());
+  out.put_bool(kept.count(top) > 0);
+  if (kept.count(top) > 0) {
+    save_children(out, *top, kept);
+  }
+  carried = out.data();
+}
+
+void MCTS_Core::save_children(state_codec::Writer &out, const Children &children, const set<const Children*> &kept) const {
+  out.put_varint(children.cur_player);
+  out.put_varint(children.cursor);
+  out.put_bool(children.complete.load(memory_order_acquire));
+  out.put_varint(children.size.load(memory_order_acquire));
+  for_each_child(children, [&](const ChildBlock *block, int i) {
+    out.put_varint(block->moves[i]);
+    out.put_varint(block->n_plays[i].load());
+    out.put_int(block->payoffs[i].load());
+    const Children *next = block->next[i].load(memory_order_acquire);
+    out.put_bool(kept.count(next) > 0);
+    if (kept.count(next) > 0) {
+      save_children(out, *next, kept);
+    }
+  });
+}
+
+Children *MCTS_Core::load_children(state_codec::Reader &in, Arena &arena) const {
+  const int cur_player = in.get_varint();
+  const int cursor = in.get_varint();
+  const bool complete = in.get_bool();
+  const int size = in.get_varint();
+  if (!in.good() || cur_player >= parent->get_num_punters() || cursor > (int)maybe_unused_edge.size() ||
+      size > Children::block_start(Children::NUM_BLOCKS)) {
+    return nullptr;
+  }
+  Children *children = new_children(arena, cur_player, -1);
+  children->cursor = cursor;
+  children->complete = complete;
+  for (int i = 0; i < size; i++) {
+    const int move = in.get_varint();
+    const int n_plays = in.get_varint();
+    const int64_t payoff = in.get_int();
+    if (!in.good() || move >= topology.num_edges) {
+      return nullptr;
+    }
+    const Node child = add_child(arena, *children, move, n_plays);
+    *child.payoff = payoff;
+    if (in.get_bool()) {
+      Children *next = load_children(in, arena);
+      if (next == nullptr) {
+	return nullptr;
       }
+      child.children->store(next);
     }
   }
+  return children;
 }
 
-void MCTS_Core::rollback_graph(Graph* graph) const {
-  int* p = punter_back;
-  for (auto& river : graph->rivers) {
-    for (auto& r : river) {
-      r.punter = *p;
-      ++p;
-      r.option = *p;
-      ++p;
+bool MCTS_Core::restore_tree() {
+  /* before anything runs on the tree */
+  string carried;
+  carried.swap(Game::carried_search());
+  if (keep_nodes <= 0 || carried.empty()) {
+    return false;
+  }
+
+  /* the tree was saved at my last move, and every punter has moved once
+     since, in turn order from me */
+  state_codec::Reader in(carried);
+  const History &history = parent->get_history();
+  const int num_punters = parent->get_num_punters();
+  const int num_edges = in.get_varint();
+  const int history_size = in.get_varint();
+  if (!in.good() || num_edges != topology.num_edges || history_size + num_punters != (int)history.size()) {
+    return false;
+  }
+  const double saved_max_score = in.get_varint();
+  vector<int> saved_edges(in.get_varint());
+  for (int &e : saved_edges) {
+    e = in.get_varint();
+    if (e >= num_edges) return false;
+  }
+  const int saved_plays = in.get_varint();
+  if (!in.good() || !in.get_bool()) {
+    return false;
+  }
+  /* cursors index the order the tree was grown in; the edges used since
+     are skipped like any other illegal move */
+  maybe_unused_edge.swap(saved_edges);
+  auto fail = [&]() {
+    maybe_unused_edge.swap(saved_edges);
+    reset_root();
+    return false;
+  };
+  Children *children = load_children(in, workers[0].arena);
+  if (children == nullptr || !in.good()) {
+    return fail();
+  }
+
+  int n_plays = saved_plays;
+  for (int k = 0; k < num_punters && children != nullptr; k++) {
+    const int p = (parent->get_punter_id() + k) % num_punters;
+    int edge = -1;
+    for (int i = history_size; i < (int)history.size(); i++) {
+      if (history[i].punter == p && history[i].is_claim()) {
+	edge = topology.edge(history[i].src, history[i].to);
+      }
+    }
+    const Children *cur = children;
+    children = nullptr;
+    if (edge == -1 || cur->cur_player != p) {
+      break;
     }
+    for_each_child(*cur, [&](const ChildBlock *block, int i) {
+      if (block->moves[i] == edge) {
+	n_plays = block->n_plays[i];
+	children = block->next[i];
+      }
+    });
+  }
+  if (children == nullptr || children->cur_player != parent->get_punter_id()) {
+    return fail();
   }
+  root.n_plays = n_plays;
+  root.children = children;
+  raise_max_score(saved_max_score);
+  return true;
+}
+
+void MCTS_Core::backup_graph() {
+  const Graph& cur_state = parent->get_graph();
+  if (topology.num_vertices != cur_state.num_vertices) {
+    topology = CsrGraph::from_graph(cur_state);
+  } else {
+    topology.sync_from(cur_state);
+  }
+  snapshot = topology.ownership;
+  workers.resize(num_threads);
+  for (auto &worker : workers) {
+    worker.ownership = snapshot;
+    worker.scorer = IncrementalScorer(parent->get_num_punters(), parent->get_distance_table());
+    worker.scorer.load(topology, snapshot);
+    worker.rng.seed(Rng::local()(), &worker - workers.data());
+    worker.selections = 0;
+  }
+}
+
+void MCTS_Core::rollback_graph(Worker &worker) {
+  worker.ownership.restore(snapshot);
+}
+
+vector<int64_t> MCTS_Core::playout_scores(Worker &worker, const vector<int> &futures, int64_t &future_score) const {
+  if (use_playout_scorer) {
+    return worker.scorer.playout(worker.ownership, parent->get_punter_id(), futures, future_score);
+  }
+  return topology.evaluate(worker.ownership, parent->get_num_punters(), parent->get_distance_table(), parent->get_punter_id(), futures, future_score);
+}
+
+void MCTS_Core::choose_scorer(const vector<int> &futures) {
+  /* both score a few playouts from the current state: the union-find
+     joins every river given away, while the BFS of evaluate only walks the
+     components of the mines, which may be few and small */
+  const int CALIBRATION_PLAYOUTS = 8;
+  Worker &worker = workers[0];
+  double elapsed[2] = {0, 0};
+  for (int i = 0; i < CALIBRATION_PLAYOUTS; i++) {
+    vector<int> remaining_options = initial_remaining_options;
+    do_playout(worker, remaining_options);
+    for (int k = 0; k < 2; k++) {
+      use_playout_scorer = k == 1;
+      auto start_time = chrono::steady_clock::now();
+      int64_t future_score;
+      playout_scores(worker, futures, future_score);
+      elapsed[k] += chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    }
+    rollback_graph(worker);
+  }
+  use_playout_scorer = elapsed[1] < elapsed[0];
 }
 
 void MCTS_Core::calc_maybe_unused_edge() {
-  const Graph& g = parent->get_graph();
-  const int total_edges = g.num_edges;
   const bool option_enabled = parent->get_options_enabled();
 
-  num_maybe_unused_edge = 0;
-  maybe_unused_edge = maybe_unused_edge_array;
-  if (total_edges > MAX_EDGES) {
-    maybe_unused_edge_deleter.reset(new PII[total_edges]);
-    maybe_unused_edge = maybe_unused_edge_deleter.get();
-  }
-  
-  initial_remaining_options.resize(parent->get_num_punters(), g.num_mines);
-  for (size_t i = 0, rsize = g.rivers.size(); i < rsize; ++i) {
-    for (size_t j = 0; j < g.rivers[i].size(); ++j) {
-      const auto& r = g.rivers[i][j];
-      if ((int)(i) >= r.to) continue;
-      if (option_enabled) {
-	if (r.option != -1) initial_remaining_options[r.option] -= 1;
-	if (r.punter != -1 && r.option != -1) continue;
-      } else {
-	if (r.punter != -1) continue;
-      }
-      maybe_unused_edge[num_maybe_unused_edge] = PII(i, j);
-      ++num_maybe_unused_edge;
+  maybe_unused_edge.clear();
+  initial_remaining_options.resize(parent->get_num_punters(), topology.num_mines);
+  for (int e = 0; e < topology.num_edges; ++e) {
+    const int punter = snapshot.punter(e);
+    const int option = snapshot.option(e);
+    if (option_enabled) {
+      if (option != -1) initial_remaining_options[option] -= 1;
+      if (punter != -1 && option != -1) continue;
+    } else {
+      if (punter != -1) continue;
     }
+    maybe_unused_edge.push_back(e);
   }
 
-  random_shuffle(maybe_unused_edge, maybe_unused_edge + num_maybe_unused_edge);
+  Rng::local().shuffle(maybe_unused_edge.begin(), maybe_unused_edge.end());
 }
 
-void MCTS_Core::do_playout(Graph& cur_state, std::vector<int>& remaining_options) const {
+void MCTS_Core::do_playout(Worker &worker, std::vector<int>& remaining_options) const {
+  OwnershipTable &cur_state = worker.ownership;
   const bool option_enabled = parent->get_options_enabled();
-  for (int mue_idx = 0; mue_idx < num_maybe_unused_edge; ++mue_idx) {
-    const auto& ue = maybe_unused_edge[mue_idx];
-    const auto& r = cur_state.rivers[ue.first][ue.second];
-    int punter_id = rand() % parent->get_num_punters();
+  /* one draw per edge, skipped or not */
+  vector<int> &draws = worker.draws;
+  draws.resize(maybe_unused_edge.size());
+  worker.rng.fill_below(parent->get_num_punters(), draws.data(), draws.size());
+  for (size_t i = 0; i < maybe_unused_edge.size(); i++) {
+    const int e = maybe_unused_edge[i];
+    const int owner = cur_state.punter(e);
+    int punter_id = draws[i];
     if (option_enabled) {
-      if (r.punter != -1) {
-	if (r.option != -1) continue;
+      if (owner != -1) {
+	if (cur_state.option(e) != -1) continue;
 	if (remaining_options[punter_id] <= 0) continue;
-	if (r.punter == punter_id) continue;
+	if (owner == punter_id) continue;
+      }
+    } else {
+      if (owner != -1) continue;
+    }
+
+    apply_move(cur_state, e, punter_id, remaining_options);
+  }
+}
+
+bool MCTS_Core::add_legal_child(Worker &worker, Children &children, const vector<int> &remaining_options, int virtual_loss, Node &child) const {
+  /* the next legal move at this node, which cur_state is at */
+  const OwnershipTable &cur_state = worker.ownership;
+  const int cur_player = children.cur_player;
+  const bool option_enabled = parent->get_options_enabled();
+  for (; children.cursor < (int)maybe_unused_edge.size(); children.cursor++) {
+    const int e = maybe_unused_edge[children.cursor];
+    const int owner = cur_state.punter(e);
+
+    if (option_enabled) {
+      if (owner != -1) {
+	if (cur_state.option(e) != -1) continue;
+	if (remaining_options[cur_player] <= 0) continue;
+	if (owner == cur_player) continue;
       }
     } else {
-      if (r.punter != -1) continue;
+      if (owner != -1) continue;
     }
 
-    move_t move(ue.first, r.to);
-    apply_move(cur_state, move, punter_id, remaining_options);
+    children.cursor++;
+    child = add_child(worker.arena, children, e, virtual_loss);
+    return true;
+  }
+  children.complete.store(true, memory_order_release);
+  return false;
+}
+
+Node MCTS_Core::select_child(const Children &children, int parent_plays) const {
+  const int num_punters = parent->get_num_punters();
+  const double scale = max_score.load(memory_order_relaxed);
+  const double log_plays = log_memo[std::min(parent_plays, MAX_LOG - 1)];
+  double current_uct = -1;
+  const ChildBlock *current_block = nullptr;
+  int current = -1;
+  for_each_child(children, [&](const ChildBlock *block, int i) {
+    const int n_plays = block->n_plays[i].load(memory_order_relaxed);
+    const double uct = block->payoffs[i].load(memory_order_relaxed) * 1.0 / n_plays / num_punters / scale +
+      sqrt(2.0 * log_plays / n_plays);
+    if (current_uct < uct) {
+      current_block = block;
+      current = i;
+      current_uct = uct;
+    }
+  });
+  if (current_block == nullptr) {
+    return Node{nullptr, nullptr, nullptr, -1, -1};
   }
+  return Node{&current_block->n_plays[current], &current_block->payoffs[current], &current_block->next[current],
+      children.cur_player, current_block->moves[current]};
 }
 
-vector<int> MCTS_Core::run_simulation(Node *p_root, const vector<int> &futures) {
+vector<int> MCTS_Core::run_simulation(Node node, const vector<int> &futures, Worker &worker) {
   /* remaining_turns */
   const int total_edges = parent->get_graph().num_edges;
   int remaining_turns = total_edges - (int)parent->get_history().size();
-  const bool option_enabled = parent->get_options_enabled();
 
-  Node *cur_node = p_root;
+  OwnershipTable& cur_state = worker.ownership;
 
-  Graph& cur_state = *parent->mutable_graph();
+  /* on a shared tree, a play counts in n_plays from the moment it enters
+     a node, with payoff 0 until it is backed up */
+  const int virtual_loss = (num_threads > 1 && parallelism == TREE) ? 1 : 0;
+  *node.n_plays += virtual_loss;
 
-  set<int> visited;
-  bool expanded = false;
   int cur_player = parent->get_punter_id();
 
-  vector<Node*> visited_nodes;
-  visited_nodes.push_back(cur_node);
-
+  vector<Node> &visited_nodes = worker.path;
+  visited_nodes.clear();
+  visited_nodes.push_back(node);
 
   vector<int> remaining_options = initial_remaining_options;
 
-  int num_turn = 0;
-
   while(--remaining_turns >= 0) {
-    ++num_turn;
     int next_player = (cur_player + 1) % parent->get_num_punters();
 
-    const double inf = 1e20;
-    double current_uct = -1;
-    move_t current_move;
-    Node *next_node = nullptr;
-
-    for (int mue_idx = 0; mue_idx < num_maybe_unused_edge; ++mue_idx) {
-      const auto& ue = maybe_unused_edge[mue_idx];
-      const auto& r = cur_state.rivers[ue.first][ue.second];
-
-      if (option_enabled) {
-	if (r.punter != -1) {
-	  if (r.option != -1) continue;
-	  if (remaining_options[cur_player] <= 0) continue;
-	  if (r.punter == cur_player) continue;
-	}
-      } else {
-	if (r.punter != -1) continue;
+    Children *children = node.children->load(memory_order_acquire);
+    if (children == nullptr) {
+      children = new_children(worker.arena, cur_player, -1);
+      /* another worker may have got here first; then its node is used */
+      Children *first = nullptr;
+      if (!node.children->compare_exchange_strong(first, children, memory_order_acq_rel)) {
+	children = first;
       }
+    }
 
-      move_t move(ue.first, r.to);
-      double uct;
-      auto it = cur_node->children.find(move);
-      Node *c = nullptr;
-      if (it != cur_node->children.end()) {
-	c = it->second.get();
-	uct = c->payoffs[cur_player] * 1.0 / c->n_plays / parent->get_num_punters() / max_score + 
-	  sqrt(2.0 * log_memo[std::min(cur_node->n_plays, MAX_LOG - 1)] / c->n_plays);
+    /* a legal move not tried yet has an infinite UCT: expand it */
+    ++worker.selections;
+    bool expanded = false;
+    Node next{nullptr, nullptr, nullptr, -1, -1};
+    if (!children->complete.load(memory_order_acquire)) {
+      if (children->adding.test_and_set(memory_order_acquire)) {
+	/* another worker is expanding this node: play out from here */
+	expanded = true;
       } else {
-	uct = inf;
-      }
-
-      if (current_uct < uct) {
-	next_node = c;
-	current_move = move;
-	current_uct = uct;
+	expanded = add_legal_child(worker, *children, remaining_options, virtual_loss, next);
+	children->adding.clear(memory_order_release);
       }
     }
-
-    move_t move = current_move;
-
-    if (move.first == inf) {
-      const set<int> visited_sites = get_visited_sites(parent, visited_nodes, next_player);
-      move_t greedy_move = get_next_greedy(parent, cur_state, visited_sites, next_player);
-      if (greedy_move.first != -1 && greedy_move.second != -1) {
-	move = greedy_move;
+    if (!expanded) {
+      next = select_child(*children, node.n_plays->load(memory_order_relaxed));
+      if (next.n_plays == nullptr) {
+	break; /* no legal move is left */
       }
+      *next.n_plays += virtual_loss;
     }
-
-    if (!expanded && next_node == nullptr) {
-      /* expand node */
-      expanded = true;
-      auto node = unique_ptr<Node>(new Node(parent->get_num_punters(), cur_player, move));
-      next_node = node.get();
-      cur_node->children[move] = std::move(node);
+    if (next.n_plays != nullptr) {
+      apply_move(cur_state, next.move, cur_player, remaining_options);
+      node = next;
+      visited_nodes.push_back(node);
+      cur_player = next_player;
     }
-    apply_move(cur_state, move, cur_player, remaining_options);
-
-    if (next_node != nullptr) {
-      cur_node = next_node;
-      visited_nodes.push_back(cur_node);
-    }
-
-    cur_player = next_player;
     if (!expanded) {
       continue;
     }
 
-    do_playout(cur_state, remaining_options);
+    do_playout(worker, remaining_options);
     break;
   }
 
   /* determine expected payoff of this playout */
   vector<int> payoffs(parent->get_num_punters());
   int64_t future_score; /* dummy; assigned by the following call */
-  vector<int64_t> scores = cur_state.evaluate(parent->get_num_punters(), parent->get_shortest_distances(), parent->get_punter_id(), futures, future_score);
+  vector<int64_t> scores = playout_scores(worker, futures, future_score);
 
   for(int i=0; i<(int)scores.size(); i++) {
     payoffs[i] = scores[i];
-    max_score = max(max_score, scores[i] * 1.0);
+    raise_max_score(scores[i]);
   }
 
   /* back propagate */
-  for(auto p : visited_nodes) {
-    p->n_plays += 1;
-    for(int i=0; i<(int)parent->get_num_punters(); i++) p->payoffs[i] += payoffs[i];
+  for(const Node &p : visited_nodes) {
+    *p.n_plays += 1 - virtual_loss;
+    if (p.payoff) *p.payoff += payoffs[p.player];
   }
 
 
   /* rollback graph */
-  rollback_graph(&cur_state);
+  rollback_graph(worker);
 
   if (future_score < - scores[parent->get_punter_id()] * 0.1) {
     payoffs[parent->get_punter_id()] = -10;
@@ -389,57 +701,54 @@ void MCTS_Core::run_futures_selection(vector<int> &futures, int target) {
   /* regard the 1st level of tree as "dummy step", which selects futures[target] */
   //	futures[target] = ;
 
-  Node *cur_node = &root;
   int cur_player = parent->get_punter_id();
   int num_mines = parent->get_graph().num_mines;
   int num_vertices = parent->get_graph().num_vertices;
+  Children *children = root.children;
+  if (children == nullptr || children->target != target) {
+    reset_root();
+    children = new_children(workers[0].arena, cur_player, target);
+    for(int i=num_mines; i<num_vertices+1; i++) { /* do not select mine to mine */
+      add_child(workers[0].arena, *children, i == num_vertices ? -1 : i, 0); /* bet on (target -> i), where -1 means 'do not connect target to anywhere' */
+    }
+    children->complete = true;
+    root.children = children;
+  }
+
   /* get next legal moves */
-  vector<pair<double, move_t>> legal_moves;
+  vector<pair<double, Node>> legal_moves;
   const double inf = 1e20;
-  for(int i=num_mines; i<num_vertices+1; i++) { /* do not select mine to mine */
-    move_t move(target, i == num_vertices ? -1 : i); /* bet on (target -> i), where -1 means 'do not connect target to anywhere' */
+  for_each_child(*children, [&](const ChildBlock *block, int i) {
+    const int n_plays = block->n_plays[i];
     double uct;
-    if (cur_node->children.count(move)) {
-      Node *c = cur_node->children[move].get();
-      uct = c->payoffs[cur_player] * 1.0 / c->n_plays / parent->get_num_punters() + sqrt(2.0 * log(cur_node->n_plays * 1.0) / c->n_plays);
+    if (n_plays > 0) {
+      uct = block->payoffs[i] * 1.0 / n_plays / parent->get_num_punters() + sqrt(2.0 * log(root.n_plays * 1.0) / n_plays);
     } else {
       uct = inf;
     }
-    legal_moves.emplace_back(uct, move);
-  }
+    legal_moves.emplace_back(uct, Node{&block->n_plays[i], &block->payoffs[i], &block->next[i], cur_player, block->moves[i]});
+  });
   /* tie break when the UCT value is equal */
-  sort(legal_moves.rbegin(), legal_moves.rend());
-  int n_candidates = 0;
-  for(n_candidates = 0; n_candidates < (int)legal_moves.size(); n_candidates++) {
-    if (n_candidates && legal_moves[n_candidates-1].first != legal_moves[n_candidates].first) break;
-  }
-  assert(n_candidates <= (int)legal_moves.size());
-  move_t move = legal_moves[rand() % n_candidates].second;
-
-  /* expand node */
-  if (cur_node->children.count(move) == 0) {
-    cur_node->children[move] = unique_ptr<Node>(new Node(parent->get_num_punters(), cur_player, move));
+  double best_uct = -inf;
+  for(const auto &p : legal_moves) best_uct = max(best_uct, p.first);
+  vector<Node> candidates;
+  for(const auto &p : legal_moves) {
+    if (p.first == best_uct) candidates.push_back(p.second);
   }
-  Node *child = cur_node->children[move].get();
+  const Node child = candidates[Rng::local().below(candidates.size())];
 
-  /* apply move */
-  if (move.second == -1) { /* do not use futures[target] */
-    futures[target] = -1;
-  } else { /* weger (target -> move.second) !! */
-    futures[target] = move.second;
-  }
+  /* apply move: -1 does not use futures[target] */
+  futures[target] = child.move;
 
-  vector<int> payoffs = run_simulation(child, futures);
-  for(int i=0; i<(int)payoffs.size(); i++) {
-    child->n_plays += 1;
-    child->payoffs[i] += payoffs[i];
-  }
+  vector<int> payoffs = run_simulation(child, futures, workers[0]);
+  *child.n_plays += (int)payoffs.size();
+  *child.payoff += payoffs[cur_player];
   /*
     if (payoffs[cur_player] < 1.0) {
     child->payoffs[cur_player] -= 1e10;
     }
   */
-  cur_node->n_plays += 1;
+  root.n_plays += 1;
 }
 
 vector<int> MCTS_Core::get_futures(int timelimit_ms) {
@@ -453,7 +762,7 @@ vector<int> MCTS_Core::get_futures(int timelimit_ms) {
   vector<int> futures(num_mines, -1);
   vector<int> perm(num_mines);
   for(int i=0; i<num_mines; i++) perm[i] = i;
-  random_shuffle(perm.begin(), perm.end());
+  Rng::local().shuffle(perm.begin(), perm.end());
   /* fill out futures[perm[0]], futures[perm[1]]... */
 
   for(int i=0; i<num_mines; i++) {
@@ -470,14 +779,15 @@ vector<int> MCTS_Core::get_futures(int timelimit_ms) {
 
     vector<tuple<double, int, int>> candidates;
     cerr << "----" << endl;
-    for(const auto &p : root.children) {
-      Node *child = p.second.get();
-      double e_payoff = child->payoffs[parent->get_punter_id()] * 1.0 / max(child->n_plays, 1);
-      cerr << child->from << " -> " << child->to << " : E[payoff] = " << e_payoff << " (played " << child->n_plays << " times)"<< endl;
-      candidates.emplace_back(e_payoff, child->from, child->to);
-    }
+    const Children *children = root.children;
+    for_each_child(*children, [&](const ChildBlock *block, int k) {
+      if (block->n_plays[k] == 0) return;
+      double e_payoff = block->payoffs[k] * 1.0 / block->n_plays[k];
+      cerr << children->target << " -> " << block->moves[k] << " : E[payoff] = " << e_payoff << " (played " << block->n_plays[k] << " times)"<< endl;
+      candidates.emplace_back(e_payoff, children->target, block->moves[k]);
+    });
     sort(candidates.rbegin(), candidates.rend());
-    auto scores = parent->get_graph().evaluate(parent->get_num_punters(), parent->get_shortest_distances());
+    auto scores = parent->get_graph().evaluate(parent->get_num_punters(), parent->get_distance_table());
     assert(get<1>(candidates[0]) == j);
 
     double e_payoff = get<0>(candidates[0]);
@@ -494,5 +804,6 @@ vector<int> MCTS_Core::get_futures(int timelimit_ms) {
     //		root.children
   }
 
+  reset_root();
   return futures;
 }
@@ -2,65 +2,174 @@
 #include <memory>
 #include <map>
 #include <unordered_map>
+#include <atomic>
+#include <set>
 
 #include "Game.h"
+#include "CsrGraph.h"
+#include "IncrementalScorer.h"
+#include "Rng.h"
+#include "StateCodec.h"
 
 using namespace std;
 
 typedef pair<int, int> move_t;
+
+/* bump allocator for the search tree; it only grows, and everything in it
+   goes at once with clear() (or the arena) */
+class Arena {
+  static const size_t CHUNK_BYTES = 1 << 20;
+  vector<unique_ptr<char[]>> chunks;
+  size_t used; /* in chunks.back() */
+  size_t total;
+public:
+  Arena() : used(CHUNK_BYTES), total(0) {}
+  void *allocate(size_t bytes);
+  void clear() { chunks.clear(); used = CHUNK_BYTES; total = 0; }
+  size_t bytes() const { return total; }
+};
+
+struct Children;
+
+/* a run of children: their counters side by side in flat arrays */
+struct ChildBlock {
+  atomic<int64_t> *payoffs; /* total payoff of the player who moves */
+  atomic<Children*> *next;  /* the children of each child */
+  atomic<int> *n_plays;
+  int *moves;               /* edge ids, or future sites (-1: no future) */
+};
+
+/* the children of one node of the tree, allocated in an Arena.  They are
+   added in the order of maybe_unused_edge (the first legal move not tried
+   yet has an infinite UCT), into blocks of 2, 8, 32, ... slots that never
+   move, so that selection is one scan over a few flat arrays and the
+   counters can be updated while others are added.  A node gets its
+   Children when a simulation first selects from it. */
+struct Children {
+  static const int NUM_BLOCKS = 10;
+  static int block_capacity(int b) { return 2 << (2 * b); }
+  static int block_start(int b) { return 2 * ((1 << (2 * b)) - 1) / 3; }
+
+  atomic<int> size;      /* children published */
+  atomic<bool> complete; /* no legal move is left to add */
+  atomic_flag adding = ATOMIC_FLAG_INIT; /* held while a child is added */
+  int cursor;            /* index in maybe_unused_edge to look for the next one */
+  int cur_player;        /* who's turn? */
+  int target;            /* get_futures: the mine the moves bet on; -1 for rivers */
+  atomic<ChildBlock*> blocks[NUM_BLOCKS];
+
+  Children(int cur_player, int target) : size(0), complete(false), cursor(0), cur_player(cur_player), target(target) {
+    for (auto &block : blocks) block = nullptr;
+  }
+};
+
+/* where the counters of a node are: a slot of its parent's Children, or a
+   Tree for the root (which has no payoff) */
 struct Node {
-  vector<int> payoffs; /* total payoff for each player */
-  int n_plays; /* number of plays, wins */
-  int from, to; /* river */
-  int cur_player; /* who's turn? */
-	
-  map<move_t, unique_ptr<Node>> children;
-  
-  Node(int num_punters, int cur_player, move_t move) : payoffs(num_punters), n_plays(0), from(move.first), to(move.second), cur_player(cur_player) { };
+  atomic<int> *n_plays;
+  atomic<int64_t> *payoff; /* of player */
+  atomic<Children*> *children;
+  int player;
+  int move;
+};
+
+struct Tree {
+  atomic<int> n_plays;
+  atomic<Children*> children;
+  Tree() : n_plays(0), children(nullptr) {}
+  Node node() { return Node{&n_plays, nullptr, &children, -1, -1}; }
 };
 
 struct MCTS_Core {
   static const int MAX_LOG = 1024;
   double log_memo[MAX_LOG];
 
-  static const int MAX_EDGES = 20000;
-  int punter_back_array[MAX_EDGES];
-  int *punter_back;
-  std::unique_ptr<int[]> punter_back_deleter;
+  /* get_play searches on num_threads workers (PUNTER_THREADS, see
+     ThreadPool).  TREE: all of them descend the shared tree, and a worker
+     counts its play in every node on its path as soon as it enters it
+     (virtual loss), so that the others spread over other moves until the
+     payoff arrives.  ROOT (PUNTER_MCTS_PARALLEL=root): every worker grows
+     a tree of its own, and the root children are summed into root at the
+     end. */
+  enum Parallelism { TREE, ROOT };
+  int num_threads;
+  Parallelism parallelism;
+
+  /* simulations run on the CSR topology; only the ownership table is
+     modified, and restored from the snapshot after every playout */
+  CsrGraph topology;
+  OwnershipTable snapshot;
 
-  struct PII{
-    int first, second;
-    PII(int first, int second) : first(first), second(second) {}
-    PII(){};
+  /* the state of one simulating thread */
+  struct Worker {
+    OwnershipTable ownership;
+    IncrementalScorer scorer; /* loaded with the snapshot */
+    Rng rng; /* seeded from Rng::local() at every get_play */
+    Arena arena; /* the nodes it expands */
+    long long selections;
+    vector<Node> path; /* scratch */
+    vector<int> draws; /* scratch of do_playout */
   };
+  vector<Worker> workers;
 
-  std::unique_ptr<PII[]> maybe_unused_edge_deleter;
-  int num_maybe_unused_edge;
-  PII maybe_unused_edge_array[MAX_EDGES];
-  PII* maybe_unused_edge;
+  /* tree reuse: get_play leaves the tree in Game::carried_search(), and
+     the next get_play starts from the node the moves played since lead to,
+     when it is there.  Offline, the groups of children under the most
+     played nodes are kept, keep_nodes children at most (PUNTER_MCTS_KEEP,
+     512, 2.5 to 5 KB of state per turn against 30 to 40 KB for 4096); in
+     persistent mode all of them.  0 turns it off. */
+  int keep_nodes;
+  bool restore_tree();
+  void save_tree() const;
+
+  vector<int> maybe_unused_edge; /* edge ids */
   vector<int> initial_remaining_options;
   void calc_maybe_unused_edge();
 
-  void do_playout(Graph& cur_state, std::vector<int>& remaining_options) const;
+  /* gives every edge of maybe_unused_edge to a random punter, on the
+     worker's ownership table */
+  void do_playout(Worker &worker, std::vector<int>& remaining_options) const;
+
+  /* the payoffs of a playout come from the workers' IncrementalScorer or from
+     CsrGraph::evaluate, which give the same scores; get_play times a few
+     playouts with each and keeps the faster */
+  bool use_playout_scorer;
+  void choose_scorer(const vector<int> &futures);
+  vector<int64_t> playout_scores(Worker &worker, const vector<int> &futures, int64_t &future_score) const;
 
   vector<int> connected_mine;
   void calc_connected_mine();
 
   void backup_graph();
-  void rollback_graph(Graph* graph) const;
+  void rollback_graph(Worker &worker);
 
   Game *parent;
   const double epsilon;
-  MCTS_Core(Game *parent, const double epsilon = 0.0) : parent(parent), epsilon(epsilon), root(parent->get_num_punters(), -1, make_pair(-1, -1)), max_score(1.0) {}
+  MCTS_Core(Game *parent, const double epsilon = 0.0);
   void run_simulation();
 
-  void reset_root() {
-	  root = Node(parent->get_num_punters(), -1, make_pair(-1, -1));
-  }
-  vector<int> run_simulation(Node *p_root, const vector<int> &futures);
+  void reset_root();  /* frees the whole tree */
+  vector<int> run_simulation(Node node, const vector<int> &futures, Worker &worker);
   pair<int, int> get_play(int timelimit_ms);
+  move_t best_play() const;  // the root child with the best expected payoff
   vector<int> get_futures(int timelimit_ms);
-  Node root;
+  Tree root;
   void run_futures_selection(vector<int> &futures, int target);
-  double max_score;
+  atomic<double> max_score;
+  void raise_max_score(double score);
+
+private:
+  Children *new_children(Arena &arena, int cur_player, int target) const;
+  Node add_child(Arena &arena, Children &children, int move, int n_plays) const;
+  bool add_legal_child(Worker &worker, Children &children, const vector<int> &remaining_options, int virtual_loss, Node &child) const;
+  Node select_child(const Children &children, int parent_plays) const;
+  move_t best_child(const Tree &tree) const;
+  /* n_plays and payoffs of the root children of |tree|, by edge */
+  void sum_root(const Tree &tree, map<int, pair<int, int64_t>> &stats) const;
+  /* the same summed over the root and, in ROOT mode, trees[1..] */
+  void sum_roots(const vector<Tree> &trees, map<int, pair<int, int64_t>> &stats) const;
+  /* the best child by the sums of sum_roots */
+  move_t best_summed_child(const vector<Tree> &trees) const;
+  void save_children(state_codec::Writer &out, const Children &children, const set<const Children*> &kept) const;
+  Children *load_children(state_codec::Reader &in, Arena &arena) const;
 };
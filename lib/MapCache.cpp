@@ -0,0 +1,255 @@
+#include "MapCache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * artifact layout (int32 words):
+ *   magic, version, num_vertices, num_mines, num_edges,
+ *   reverse_id_map[num_vertices],
+ *   offsets[num_vertices + 1], neighbours[2 * num_edges] (sorted per vertex),
+ *   distances[num_mines * num_vertices]
+ */
+
+namespace {
+  const int32_t MAGIC = 0x31434d50;  // "PMC1"
+  const int32_t VERSION = 1;
+  const int HEADER_WORDS = 5;
+
+  const char* DEFAULT_CACHE_DIR = "/tmp/punter_map_cache";
+
+  std::string cache_dir() {
+    const char* dir = getenv("PUNTER_CACHE_DIR");
+    return dir ? dir : DEFAULT_CACHE_DIR;
+  }
+
+  size_t artifact_words(int num_vertices, int num_mines, int num_edges) {
+    return HEADER_WORDS + num_vertices + (num_vertices + 1) + 2 * (size_t)num_edges
+      + (size_t)num_mines * num_vertices;
+  }
+
+  // an artifact of the current format whose size matches its header
+  bool valid_header(const int32_t* header, size_t bytes) {
+    return header[0] == MAGIC && header[1] == VERSION
+      && header[2] >= 0 && header[3] >= 0 && header[3] <= header[2] && header[4] >= 0
+      && bytes == artifact_words(header[2], header[3], header[4]) * sizeof(int32_t);
+  }
+
+  // whether |path| holds a valid artifact for a map of |graph|'s size
+  bool stored(const std::string& path, const Graph& graph) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    int32_t header[HEADER_WORDS];
+    const bool read_ok = fstat(fd, &st) == 0
+      && read(fd, header, sizeof(header)) == (ssize_t)sizeof(header);
+    close(fd);
+    return read_ok && valid_header(header, st.st_size)
+      && header[2] == graph.num_vertices && header[3] == graph.num_mines
+      && header[4] == graph.num_edges;
+  }
+
+  struct Artifact {
+    Graph graph;
+    IdMap id_map;
+    std::vector<std::vector<int>> distances;
+  };
+
+  const size_t MAX_PRELOADED = 16;
+  std::map<uint64_t, Artifact> preloaded;
+
+  bool load_file(uint64_t hash, Graph& graph,
+                 IdMap& id_map,
+                 std::vector<std::vector<int>>& distances);
+}
+
+namespace map_cache {
+
+uint64_t
+fnv1a(const void* data, size_t size, uint64_t h) {
+  const uint8_t* p = (const uint8_t*)data;
+  for (size_t i = 0; i < size; ++i) {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+uint64_t
+hash_map(const protocol::SetupMessage& msg) {
+  std::vector<int32_t> words;
+  words.reserve(3 + msg.sites.size() + msg.mines.size() + 3 * msg.rivers.size());
+  words.push_back(msg.sites.size());
+  words.insert(words.end(), msg.sites.begin(), msg.sites.end());
+  words.push_back(msg.mines.size());
+  words.insert(words.end(), msg.mines.begin(), msg.mines.end());
+  words.push_back(msg.rivers.size());
+  for (const auto& river : msg.rivers) {
+    words.push_back(river.source);
+    words.push_back(river.target);
+    words.push_back(river.punter);
+  }
+  return fnv1a(words.data(), words.size() * sizeof(int32_t));
+}
+
+std::string
+cache_path(uint64_t hash) {
+  char name[32];
+  snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)hash);
+  return cache_dir() + name;
+}
+
+bool
+store(uint64_t hash, const Graph& graph,
+      const IdMap& id_map,
+      const std::vector<std::vector<int>>& distances) {
+  const std::string path = cache_path(hash);
+  // a stale, older-version or truncated file is replaced below, since
+  // later turns would fail to load it
+  if (stored(path, graph)) {
+    return true;
+  }
+  mkdir(cache_dir().c_str(), 0777);
+
+  std::vector<int32_t> words;
+  words.reserve(artifact_words(graph.num_vertices, graph.num_mines, graph.num_edges));
+  words.push_back(MAGIC);
+  words.push_back(VERSION);
+  words.push_back(graph.num_vertices);
+  words.push_back(graph.num_mines);
+  words.push_back(graph.num_edges);
+  words.insert(words.end(), id_map.vertices().begin(), id_map.vertices().end());
+  int offset = 0;
+  for (int u = 0; u < graph.num_vertices; ++u) {
+    words.push_back(offset);
+    offset += graph.rivers[u].size();
+  }
+  words.push_back(offset);
+  for (int u = 0; u < graph.num_vertices; ++u) {
+    for (const auto& river : graph.rivers[u]) {
+      words.push_back(river.to);
+    }
+  }
+  for (const auto& dist : distances) {
+    words.insert(words.end(), dist.begin(), dist.end());
+  }
+  if (words.size() != artifact_words(graph.num_vertices, graph.num_mines, graph.num_edges)) {
+    return false;
+  }
+
+  // write to a private file first so that concurrent punters never see
+  // a partially written artifact
+  const std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+  FILE* fp = fopen(tmp_path.c_str(), "wb");
+  if (!fp) {
+    return false;
+  }
+  const bool written = fwrite(words.data(), sizeof(int32_t), words.size(), fp) == words.size();
+  if (fclose(fp) != 0 || !written || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool
+load(uint64_t hash, Graph& graph,
+     IdMap& id_map,
+     std::vector<std::vector<int>>& distances) {
+  const auto it = preloaded.find(hash);
+  if (it != preloaded.end()) {
+    graph = it->second.graph;
+    id_map = it->second.id_map;
+    distances = it->second.distances;
+    return true;
+  }
+  return load_file(hash, graph, id_map, distances);
+}
+
+bool
+preload(uint64_t hash) {
+  if (preloaded.count(hash)) {
+    return true;
+  }
+  Artifact artifact;
+  if (!load_file(hash, artifact.graph, artifact.id_map, artifact.distances)) {
+    return false;
+  }
+  if (preloaded.size() >= MAX_PRELOADED) {
+    preloaded.clear();
+  }
+  preloaded[hash] = std::move(artifact);
+  return true;
+}
+
+}
+
+namespace {
+
+bool
+load_file(uint64_t hash, Graph& graph,
+          IdMap& id_map,
+          std::vector<std::vector<int>>& distances) {
+  const std::string path = map_cache::cache_path(hash);
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)(HEADER_WORDS * sizeof(int32_t))) {
+    close(fd);
+    return false;
+  }
+  void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+
+  const int32_t* p = (const int32_t*)addr;
+  const int num_vertices = p[2];
+  const int num_mines = p[3];
+  const int num_edges = p[4];
+  const bool valid = valid_header(p, st.st_size);
+
+  if (valid) {
+    p += HEADER_WORDS;
+    id_map = IdMap(std::vector<int>(p, p + num_vertices));
+    p += num_vertices;
+
+    const int32_t* offsets = p;
+    const int32_t* neighbours = p + num_vertices + 1;
+    graph = Graph();
+    graph.num_vertices = num_vertices;
+    graph.num_mines = num_mines;
+    graph.num_edges = num_edges;
+    graph.rivers.resize(num_vertices);
+    for (int u = 0; u < num_vertices; ++u) {
+      auto& rs = graph.rivers[u];
+      rs.reserve(offsets[u + 1] - offsets[u]);
+      for (int i = offsets[u]; i < offsets[u + 1]; ++i) {
+        rs.emplace_back(neighbours[i]);
+      }
+    }
+    p = neighbours + 2 * (size_t)num_edges;
+
+    distances.resize(num_mines);
+    for (int mine = 0; mine < num_mines; ++mine) {
+      distances[mine].assign(p, p + num_vertices);
+      p += num_vertices;
+    }
+  }
+
+  munmap(addr, st.st_size);
+  return valid;
+}
+
+}
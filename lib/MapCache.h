@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "Game.h"
+
+/*
+ *  On-disk cache of the immutable part of a map, keyed by a hash of the
+ *  map: sorted adjacency, vertex id map and the mine distance tables.
+ *
+ *  Setup stores the artifact once, and later turns only need the hash
+ *  to rebuild the graph without running any BFS.
+ *  The directory can be changed by PUNTER_CACHE_DIR.
+ */
+
+namespace map_cache {
+
+// FNV-1a of |size| bytes, continued from |h|
+uint64_t fnv1a(const void* data, size_t size, uint64_t h = 14695981039346656037ULL);
+// the key of the map of a setup message: fnv1a over its sites, mines and
+// rivers as parsed, so that the same map has one key whichever parser read
+// it and however its JSON is spaced
+uint64_t hash_map(const protocol::SetupMessage& msg);
+std::string cache_path(uint64_t hash);
+
+// the graph must not have any claimed river; a file already at the path
+// counts only if load() would accept it, and is replaced otherwise
+bool store(uint64_t hash, const Graph& graph,
+           const IdMap& id_map,
+           const std::vector<std::vector<int>>& distances);
+
+bool load(uint64_t hash, Graph& graph,
+          IdMap& id_map,
+          std::vector<std::vector<int>>& distances);
+
+// keeps the decoded artifact in this process so that later load() calls
+// copy it from memory; forked processes inherit it (see Zygote.h)
+bool preload(uint64_t hash);
+
+}
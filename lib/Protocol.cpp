@@ -0,0 +1,611 @@
+#include "Protocol.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+
+namespace {
+
+/*
+ *  Minimal pull parser over a JSON text.  Any syntax it does not expect
+ *  clears |ok| and the remaining calls become no-ops.
+ */
+struct Cursor {
+  const char* p;
+  const char* end;
+  bool ok;
+
+  Cursor(const char* begin, const char* end) : p(begin), end(end), ok(true) {}
+
+  void ws() {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+  }
+
+  bool peek(char c) {
+    ws();
+    return ok && p < end && *p == c;
+  }
+
+  bool consume(char c) {
+    if (!peek(c)) return false;
+    ++p;
+    return true;
+  }
+
+  void expect(char c) {
+    if (!consume(c)) ok = false;
+  }
+
+  // raw key without unescaping; protocol keys never contain escapes
+  void key(const char*& k, size_t& len) {
+    expect('"');
+    k = p;
+    while (ok && p < end && *p != '"') {
+      if (*p == '\\') ++p;
+      ++p;
+    }
+    if (p >= end) ok = false;
+    len = p - k;
+    ++p;
+    expect(':');
+  }
+
+  int integer() {
+    ws();
+    bool neg = false;
+    if (p < end && *p == '-') {
+      neg = true;
+      ++p;
+    }
+    if (p >= end || *p < '0' || '9' < *p) {
+      ok = false;
+      return 0;
+    }
+    int64_t x = 0;
+    while (p < end && '0' <= *p && *p <= '9') {
+      x = x * 10 + (*p++ - '0');
+    }
+    if (p < end && (*p == '.' || *p == 'e' || *p == 'E')) {
+      ok = false;
+    }
+    return neg ? -x : x;
+  }
+
+  bool literal(const char* word) {
+    const size_t n = strlen(word);
+    if ((size_t)(end - p) < n || strncmp(p, word, n) != 0) {
+      ok = false;
+      return false;
+    }
+    p += n;
+    return true;
+  }
+
+  bool boolean() {
+    ws();
+    if (p < end && *p == 't') return literal("true");
+    literal("false");
+    return false;
+  }
+
+  void string(std::string& out) {
+    out.clear();
+    expect('"');
+    while (ok && p < end && *p != '"') {
+      const char* run = p;
+      while (p < end && *p != '"' && *p != '\\') ++p;
+      out.append(run, p);
+      if (p < end && *p == '\\') {
+        if (++p >= end) break;
+        const char c = *p++;
+        switch (c) {
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'u': {
+          // non-ASCII text never appears in the fields parsed here
+          unsigned code = 0;
+          for (int i = 0; i < 4 && p < end; ++i, ++p) {
+            const char h = *p;
+            code = code * 16 + (h <= '9' ? h - '0' : (h | 0x20) - 'a' + 10);
+          }
+          if (code >= 0x80) ok = false;
+          out.push_back((char)code);
+          break;
+        }
+        default: out.push_back(c); break;
+        }
+      }
+    }
+    if (p >= end) ok = false;
+    ++p;
+  }
+
+  void skip_string() {
+    expect('"');
+    while (ok && p < end && *p != '"') {
+      if (*p == '\\') ++p;
+      ++p;
+    }
+    if (p >= end) ok = false;
+    ++p;
+  }
+
+  void skip() {
+    ws();
+    if (!ok || p >= end) {
+      ok = false;
+      return;
+    }
+    switch (*p) {
+    case '{':
+      ++p;
+      if (consume('}')) return;
+      do {
+        skip_string();
+        expect(':');
+        skip();
+      } while (ok && consume(','));
+      expect('}');
+      return;
+    case '[':
+      ++p;
+      if (consume(']')) return;
+      do {
+        skip();
+      } while (ok && consume(','));
+      expect(']');
+      return;
+    case '"':
+      skip_string();
+      return;
+    case 't': literal("true"); return;
+    case 'f': literal("false"); return;
+    case 'n': literal("null"); return;
+    default:
+      if (*p != '-' && (*p < '0' || '9' < *p)) {
+        ok = false;
+        return;
+      }
+      while (p < end && (strchr("+-.eE", *p) || ('0' <= *p && *p <= '9'))) ++p;
+      return;
+    }
+  }
+};
+
+bool key_is(const char* k, size_t len, const char* name) {
+  return strlen(name) == len && memcmp(k, name, len) == 0;
+}
+
+// calls f(key, len) for each member; f must consume the value
+template<class F>
+void object(Cursor& c, F f) {
+  c.expect('{');
+  if (c.consume('}')) return;
+  do {
+    const char* k;
+    size_t len;
+    c.key(k, len);
+    if (!c.ok) return;
+    f(k, len);
+  } while (c.ok && c.consume(','));
+  c.expect('}');
+}
+
+// calls f() for each element; f must consume the element
+template<class F>
+void array(Cursor& c, F f) {
+  c.expect('[');
+  if (c.consume(']')) return;
+  do {
+    f();
+  } while (c.ok && c.consume(','));
+  c.expect(']');
+}
+
+void parse_map(Cursor& c, protocol::SetupMessage& msg) {
+  object(c, [&](const char* k, size_t len) {
+    if (key_is(k, len, "sites")) {
+      array(c, [&]() {
+        int id = 0;
+        object(c, [&](const char* k, size_t len) {
+          if (key_is(k, len, "id")) {
+            id = c.integer();
+          } else {
+            c.skip();
+          }
+        });
+        msg.sites.push_back(id);
+      });
+    } else if (key_is(k, len, "rivers")) {
+      array(c, [&]() {
+        int source = 0, target = 0, punter = -1;
+        object(c, [&](const char* k, size_t len) {
+          if (key_is(k, len, "source")) {
+            source = c.integer();
+          } else if (key_is(k, len, "target")) {
+            target = c.integer();
+          } else if (key_is(k, len, "punter")) {
+            punter = c.integer();
+          } else {
+            c.skip();
+          }
+        });
+        msg.rivers.emplace_back(source, target, punter);
+      });
+    } else if (key_is(k, len, "mines")) {
+      array(c, [&]() {
+        msg.mines.push_back(c.integer());
+      });
+    } else {
+      c.skip();
+    }
+  });
+}
+
+void parse_move_entry(Cursor& c, protocol::MoveMessage& msg) {
+  object(c, [&](const char* k, size_t len) {
+    protocol::ProtocolMove::Kind kind;
+    if (key_is(k, len, "claim")) {
+      kind = protocol::ProtocolMove::CLAIM;
+    } else if (key_is(k, len, "pass")) {
+      kind = protocol::ProtocolMove::PASS;
+    } else if (key_is(k, len, "splurge")) {
+      kind = protocol::ProtocolMove::SPLURGE;
+    } else if (key_is(k, len, "option")) {
+      kind = protocol::ProtocolMove::OPTION;
+    } else {
+      c.skip();   // e.g. "scores" added by our offline server
+      return;
+    }
+    msg.moves.emplace_back(kind, -1);
+    protocol::ProtocolMove& mv = msg.moves.back();
+    object(c, [&](const char* k, size_t len) {
+      if (key_is(k, len, "punter")) {
+        mv.punter = c.integer();
+      } else if (key_is(k, len, "source")) {
+        mv.source = c.integer();
+      } else if (key_is(k, len, "target")) {
+        mv.target = c.integer();
+      } else if (key_is(k, len, "route")) {
+        array(c, [&]() {
+          mv.route.push_back(c.integer());
+        });
+      } else {
+        c.skip();
+      }
+    });
+  });
+}
+
+}
+
+namespace protocol {
+
+bool
+Reader::fill(size_t need) {
+  if (end - begin >= need) {
+    return true;
+  }
+  if (begin + need > buf.size()) {
+    memmove(buf.data(), buf.data() + begin, end - begin);
+    end -= begin;
+    begin = 0;
+    if (need > buf.size()) {
+      buf.resize(need);
+    }
+  }
+  while (end - begin < need) {
+    const ssize_t n = ::read(fd, buf.data() + end, buf.size() - end);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    end += n;
+  }
+  return true;
+}
+
+bool
+Reader::next(const char*& payload, size_t& length) {
+  size_t header = 0;
+  while (true) {
+    if (!fill(header + 1)) {
+      return false;
+    }
+    const char c = buf[begin + header];
+    if (c == ':') {
+      break;
+    }
+    if (header == 0 && (c == '\n' || c == '\r' || c == ' ')) {
+      ++begin;
+      continue;
+    }
+    ++header;
+  }
+
+  length = 0;
+  for (size_t i = 0; i < header; ++i) {
+    length = length * 10 + (buf[begin + i] - '0');
+  }
+  ++header;
+  if (!fill(header + length)) {
+    return false;
+  }
+  payload = buf.data() + begin + header;
+  begin += header + length;
+  return true;
+}
+
+bool
+Reader::pending() const {
+  if (begin < end) {
+    return true;
+  }
+  pollfd pfd = {fd, POLLIN, 0};
+  return poll(&pfd, 1, 0) > 0;
+}
+
+Reader&
+stdin_reader() {
+  static Reader reader(0);
+  return reader;
+}
+
+MessageType
+message_type(const char* payload, size_t length) {
+  Cursor c(payload, payload + length);
+  MessageType type = UNKNOWN;
+  object(c, [&](const char* k, size_t len) {
+    if (key_is(k, len, "punter")) {
+      type = SETUP;
+    } else if (key_is(k, len, "move")) {
+      type = MOVE;
+    } else if (key_is(k, len, "stop")) {
+      type = STOP;
+    } else if (key_is(k, len, "you")) {
+      type = HANDSHAKE;
+    }
+    c.skip();
+  });
+  return type;
+}
+
+bool
+parse_setup(const char* payload, size_t length, SetupMessage& msg) {
+  Cursor c(payload, payload + length);
+  object(c, [&](const char* k, size_t len) {
+    if (key_is(k, len, "punter")) {
+      msg.punter = c.integer();
+    } else if (key_is(k, len, "punters")) {
+      msg.punters = c.integer();
+    } else if (key_is(k, len, "map")) {
+      parse_map(c, msg);
+    } else if (key_is(k, len, "settings")) {
+      object(c, [&](const char* k, size_t len) {
+        if (key_is(k, len, "futures")) {
+          msg.futures = c.boolean();
+        } else if (key_is(k, len, "splurges")) {
+          msg.splurges = c.boolean();
+        } else if (key_is(k, len, "options")) {
+          msg.options = c.boolean();
+        } else {
+          c.skip();
+        }
+      });
+    } else {
+      c.skip();
+    }
+  });
+  return c.ok && msg.punter >= 0;
+}
+
+bool
+parse_move(const char* payload, size_t length, MoveMessage& msg) {
+  Cursor c(payload, payload + length);
+  object(c, [&](const char* k, size_t len) {
+    if (key_is(k, len, "move")) {
+      object(c, [&](const char* k, size_t len) {
+        if (key_is(k, len, "moves")) {
+          array(c, [&]() {
+            parse_move_entry(c, msg);
+          });
+        } else {
+          c.skip();
+        }
+      });
+    } else if (key_is(k, len, "state")) {
+      msg.has_state = true;
+      c.ws();
+      const char* state_begin = c.p;
+      object(c, [&](const char* k, size_t len) {
+        if (key_is(k, len, "blob")) {
+          c.string(msg.state_blob);
+        } else if (key_is(k, len, "info")) {
+          c.ws();
+          const char* info_begin = c.p;
+          c.skip();
+          Json::Reader reader;
+          if (c.ok && !reader.parse(info_begin, c.p, msg.info, false)) {
+            c.ok = false;
+          }
+        } else {
+          msg.legacy_state = true;
+          c.skip();
+        }
+      });
+      if (c.ok && (msg.legacy_state || msg.state_blob.empty())) {
+        msg.legacy_state = true;
+        Json::Reader reader;
+        if (!reader.parse(state_begin, c.p, msg.state, false)) {
+          c.ok = false;
+        }
+        msg.info = msg.state["info"];
+      }
+    } else {
+      c.skip();
+    }
+  });
+  return c.ok;
+}
+
+Writer::Writer() {
+  buf.reserve(1 << 16);
+  clear();
+}
+
+void
+Writer::clear() {
+  buf.assign(HEADER_SIZE, ' ');
+  first.clear();
+  after_key = false;
+}
+
+void
+Writer::separator() {
+  if (after_key) {
+    after_key = false;
+    return;
+  }
+  if (!first.empty()) {
+    if (!first.back()) {
+      buf.push_back(',');
+    }
+    first.back() = false;
+  }
+}
+
+Writer&
+Writer::begin_object() {
+  separator();
+  buf.push_back('{');
+  first.push_back(true);
+  return *this;
+}
+
+Writer&
+Writer::end_object() {
+  buf.push_back('}');
+  first.pop_back();
+  return *this;
+}
+
+Writer&
+Writer::begin_array() {
+  separator();
+  buf.push_back('[');
+  first.push_back(true);
+  return *this;
+}
+
+Writer&
+Writer::end_array() {
+  buf.push_back(']');
+  first.pop_back();
+  return *this;
+}
+
+Writer&
+Writer::key(const char* k) {
+  separator();
+  buf.push_back('"');
+  buf += k;
+  buf += "\":";
+  after_key = true;
+  return *this;
+}
+
+Writer&
+Writer::integer(int64_t x) {
+  separator();
+  char digits[24];
+  int n = 0;
+  uint64_t u = x < 0 ? -(uint64_t)x : x;
+  do {
+    digits[n++] = '0' + u % 10;
+    u /= 10;
+  } while (u);
+  if (x < 0) {
+    buf.push_back('-');
+  }
+  while (n) {
+    buf.push_back(digits[--n]);
+  }
+  return *this;
+}
+
+Writer&
+Writer::boolean(bool b) {
+  separator();
+  buf += b ? "true" : "false";
+  return *this;
+}
+
+Writer&
+Writer::string(const std::string& s) {
+  separator();
+  buf.push_back('"');
+  for (const char c : s) {
+    if (c == '"' || c == '\\') {
+      buf.push_back('\\');
+      buf.push_back(c);
+    } else if ((unsigned char)c < 0x20) {
+      char esc[8];
+      snprintf(esc, sizeof(esc), "\\u%04x", c);
+      buf += esc;
+    } else {
+      buf.push_back(c);
+    }
+  }
+  buf.push_back('"');
+  return *this;
+}
+
+Writer&
+Writer::json(const Json::Value& v) {
+  separator();
+  std::string text = Json::FastWriter().write(v);
+  if (!text.empty() && text.back() == '\n') {
+    text.pop_back();
+  }
+  buf += text;
+  return *this;
+}
+
+std::string
+Writer::message() const {
+  return std::to_string(buf.size() - HEADER_SIZE) + ":" + payload();
+}
+
+bool
+Writer::flush(int fd) {
+  char header[HEADER_SIZE + 1];
+  const int n = snprintf(header, sizeof(header), "%zu:", buf.size() - HEADER_SIZE);
+  char* start = &buf[HEADER_SIZE - n];
+  memcpy(start, header, n);
+
+  size_t remaining = buf.size() - (HEADER_SIZE - n);
+  bool ok = true;
+  while (remaining > 0) {
+    const ssize_t written = ::write(fd, start, remaining);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      ok = false;
+      break;
+    }
+    start += written;
+    remaining -= written;
+  }
+  clear();
+  return ok;
+}
+
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "json/json.h"
+
+/*
+ *  Schema-specific reader / writer for the punter protocol.
+ *
+ *  Messages are read with one read() into a reusable buffer and the
+ *  setup / move messages are parsed in place into flat structures,
+ *  without building a Json::Value DOM.  Only the AI-private 'info' part
+ *  of the state still goes through Json::Reader.
+ *
+ *  Replies are emitted directly into one preallocated buffer, which is
+ *  flushed together with its length prefix by a single write().
+ */
+
+namespace protocol {
+
+struct SetupRiver {
+  int source;
+  int target;
+  int punter;
+  SetupRiver(int source, int target, int punter = -1)
+    : source(source), target(target), punter(punter) {}
+};
+
+struct SetupMessage {
+  int punter = -1;
+  int punters = 0;
+  std::vector<int> sites;
+  std::vector<int> mines;
+  std::vector<SetupRiver> rivers;
+
+  bool futures = false;
+  bool splurges = false;
+  bool options = false;
+};
+
+struct ProtocolMove {
+  enum Kind { PASS, CLAIM, SPLURGE, OPTION };
+  Kind kind;
+  int punter;
+  int source = -1;
+  int target = -1;
+  std::vector<int> route;   // splurge only
+
+  ProtocolMove(Kind kind, int punter) : kind(kind), punter(punter) {}
+};
+
+struct MoveMessage {
+  std::vector<ProtocolMove> moves;
+
+  // false when the sender keeps no state (persistent mode)
+  bool has_state = false;
+  // binary state (see StateCodec.h) ...
+  std::string state_blob;
+  Json::Value info;
+  // ... or the legacy JSON state, which is kept as a DOM
+  bool legacy_state = false;
+  Json::Value state;
+};
+
+class Reader {
+  int fd;
+  std::vector<char> buf;
+  size_t begin, end;
+
+  bool fill(size_t need);
+public:
+  explicit Reader(int fd) : fd(fd), buf(1 << 16), begin(0), end(0) {}
+
+  // reads the next "length:payload" message; the payload stays valid
+  // until the next call
+  bool next(const char*& payload, size_t& length);
+  // whether input is already buffered or waiting on the fd
+  bool pending() const;
+};
+
+Reader& stdin_reader();
+
+class Writer {
+  static const size_t HEADER_SIZE = 24;  // room for "<length>:"
+
+  std::string buf;
+  std::vector<bool> first;  // per open container: no member written yet
+  bool after_key;
+
+  void separator();
+public:
+  Writer();
+  void clear();
+
+  Writer& begin_object();
+  Writer& end_object();
+  Writer& begin_array();
+  Writer& end_array();
+  Writer& key(const char* k);
+
+  Writer& integer(int64_t x);
+  Writer& boolean(bool b);
+  Writer& string(const std::string& s);
+  Writer& json(const Json::Value& v);  // serialized with Json::FastWriter
+
+  std::string payload() const { return buf.substr(HEADER_SIZE); }
+  bool empty() const { return buf.size() == HEADER_SIZE; }
+  // "<length>:<payload>", as flush() would write it
+  std::string message() const;
+
+  // writes "<length>:<payload>" to |fd| and clears the buffer
+  bool flush(int fd);
+};
+
+enum MessageType { HANDSHAKE, SETUP, MOVE, STOP, UNKNOWN };
+
+// classifies the message by its top level keys
+MessageType message_type(const char* payload, size_t length);
+
+// false if the payload does not follow the expected schema;
+// the caller should then fall back to the DOM path
+bool parse_setup(const char* payload, size_t length, SetupMessage& msg);
+bool parse_move(const char* payload, size_t length, MoveMessage& msg);
+
+}
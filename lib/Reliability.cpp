@@ -0,0 +1,155 @@
+#include "Reliability.h"
+#include "Rng.h"
+#include "ThreadPool.h"
+#include "TurnStats.h"
+
+#include <algorithm>
+
+namespace {
+
+/*
+ *  Random river removals
+ */
+
+class RemovalSamples {
+  int num_edges = 0;
+  int words = 0;
+  // flat adjacency; edge_ids numbers the undirected rivers in (u, to) order
+  // with u < to, which is the order the samples draw them in
+  std::vector<int> offsets, heads, edge_ids;
+  // removed rivers of every sample, one bit per river
+  std::vector<uint64_t> removed;
+public:
+  RemovalSamples(const Graph& graph, double probability, int num_samples, uint32_t seed);
+
+  // searches from |source| in |sample|; fills dist (all -1 on entry) and
+  // que, and returns the number of vertices reached
+  int bfs(int source, int sample, std::vector<int>& dist, std::vector<int>& que) const;
+};
+
+RemovalSamples::RemovalSamples(const Graph& graph, double probability, int num_samples, uint32_t seed)
+  : offsets(graph.num_vertices + 1, 0) {
+  heads.reserve(2 * graph.num_edges);
+  edge_ids.reserve(2 * graph.num_edges);
+  for (int u = 0; u < graph.num_vertices; ++u) {
+    for (const Graph::River& river : graph.rivers[u]) {
+      heads.push_back(river.to);
+      if (u < river.to) {
+        edge_ids.push_back(num_edges++);
+      } else {
+        // the reverse half was numbered when river.to was visited
+        const auto& rs = graph.rivers[river.to];
+        const int j = std::lower_bound(rs.begin(), rs.end(), Graph::River(u)) - rs.begin();
+        edge_ids.push_back(edge_ids[offsets[river.to] + j]);
+      }
+    }
+    offsets[u + 1] = heads.size();
+  }
+
+  words = (num_edges + 63) / 64;
+  removed.resize((size_t)num_samples * words);
+  const uint64_t threshold = Rng::threshold(probability);
+  ThreadPool::shared().parallel_for(num_samples, [&](int sample, int) {
+    Rng rng(seed, sample);
+    rng.fill_bernoulli(threshold, &removed[(size_t)sample * words], num_edges);
+  });
+}
+
+int
+RemovalSamples::bfs(int source, int sample, std::vector<int>& dist, std::vector<int>& que) const {
+  turn_stats::count(turn_stats::BFS);
+  const uint64_t* bits = &removed[(size_t)sample * words];
+  int qb = 0, qe = 0;
+  que[qe++] = source;
+  dist[source] = 0;
+  while (qb < qe) {
+    const int u = que[qb++];
+    for (int h = offsets[u]; h < offsets[u + 1]; ++h) {
+      const int v = heads[h];
+      const int e = edge_ids[h];
+      if (dist[v] == -1 && !(bits[e >> 6] >> (e & 63) & 1)) {
+        dist[v] = dist[u] + 1;
+        que[qe++] = v;
+      }
+    }
+  }
+  return qe;
+}
+
+// runs body(mine, dist, que, reached) for every mine and sample, the
+// samples of a mine in order on one worker
+void
+for_each_search(const Graph& graph, const RemovalSamples& samples, int num_samples,
+                const std::function<void(int, const std::vector<int>&, const std::vector<int>&, int)>& body) {
+  ThreadPool& pool = ThreadPool::shared();
+  std::vector<std::vector<int>> dists(pool.size(), std::vector<int>(graph.num_vertices, -1));
+  std::vector<std::vector<int>> ques(pool.size(), std::vector<int>(graph.num_vertices));
+  pool.parallel_for(graph.num_mines, [&](int mine, int worker) {
+    std::vector<int>& dist = dists[worker];
+    std::vector<int>& que = ques[worker];
+    for (int sample = 0; sample < num_samples; ++sample) {
+      const int reached = samples.bfs(mine, sample, dist, que);
+      body(mine, dist, que, reached);
+      for (int i = 0; i < reached; ++i) {
+        dist[que[i]] = -1;
+      }
+    }
+  });
+}
+
+}
+
+namespace reliability {
+
+std::vector<std::vector<double>>
+future_scores(const Graph& graph, const DistanceMatrix& shortest_distances,
+              int turn_limit, double epsilon, int num_samples, uint32_t seed) {
+  const RemovalSamples samples(graph, epsilon, num_samples, seed);
+  std::vector<std::vector<double>> scores(graph.num_mines, std::vector<double>(graph.num_vertices, 0));
+  for_each_search(graph, samples, num_samples,
+                  [&](int mine, const std::vector<int>& dist, const std::vector<int>& que, int reached) {
+    const DistanceMatrix::Row full = shortest_distances[mine];
+    std::vector<double>& score = scores[mine];
+    // the vertices not reached score nothing, and the mine itself has d2 = 0
+    for (int i = 1; i < reached; ++i) {
+      const int v = que[i];
+      if (full[v] < turn_limit) {
+        const double d1 = full[v], d2 = dist[v];
+        score[v] += d1 * d1 * d1 / (d2 * d2);
+      }
+    }
+  });
+  return scores;
+}
+
+std::vector<std::vector<double>>
+mine_closeness(const Graph& graph, double epsilon, int num_samples, uint32_t seed) {
+  const RemovalSamples samples(graph, epsilon, num_samples, seed);
+  std::vector<std::vector<double>> closeness(graph.num_mines, std::vector<double>(graph.num_mines, 0));
+  for_each_search(graph, samples, num_samples,
+                  [&](int mine, const std::vector<int>& dist, const std::vector<int>&, int) {
+    for (int m = 0; m < graph.num_mines; ++m) {
+      if (dist[m] > 0) {
+        closeness[mine][m] += 1.0 / dist[m];
+      }
+    }
+  });
+  return closeness;
+}
+
+std::pair<int, int>
+best_future(const std::vector<std::vector<double>>& scores, int first_target) {
+  int best_source = 0;
+  int best_target = 0;
+  for (int m = 0; m < (int)scores.size(); m++) {
+    for (int v = first_target; v < (int)scores[m].size(); v++) {
+      if (scores[m][v] > scores[best_source][best_target]) {
+        best_source = m;
+        best_target = v;
+      }
+    }
+  }
+  return std::make_pair(best_source, best_target);
+}
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Game.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+ *  Sampled reliability of mine -> site routes, used to pick a future at
+ *  setup.
+ *
+ *  Each sample removes every river independently with probability epsilon
+ *  and searches from every mine on what is left; a site v gains
+ *  d1^3 / d2^2 for mine m, where d1 is the distance on the full map and d2
+ *  the one after the removal, when it is still reachable and d1 is below
+ *  the turn limit.  Sample i draws from its own generator seeded with
+ *  (seed, i), and every mine sums its samples in order, so the scores do
+ *  not depend on the number of threads of ThreadPool::shared().
+ */
+
+namespace reliability {
+  // scores[mine][v] summed over |num_samples| samples
+  std::vector<std::vector<double>> future_scores(
+    const Graph& graph, const DistanceMatrix& shortest_distances,
+    int turn_limit, double epsilon, int num_samples, uint32_t seed);
+
+  // closeness[mine][m] = sum of 1 / d over the samples in which mine m is
+  // reachable from |mine| at distance d > 0
+  std::vector<std::vector<double>> mine_closeness(
+    const Graph& graph, double epsilon, int num_samples, uint32_t seed);
+
+  // (mine, v) of the highest score with v >= first_target; ties go to the
+  // first pair, and (0, 0) when nothing scores
+  std::pair<int, int> best_future(const std::vector<std::vector<double>>& scores, int first_target);
+}
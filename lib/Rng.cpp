@@ -0,0 +1,79 @@
+#include "Rng.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+
+uint64_t
+splitmix64(uint64_t& x) {
+  uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+}
+
+void
+Rng::seed(uint64_t seed, uint64_t stream) {
+  uint64_t x = seed;
+  x = splitmix64(x) ^ stream;
+  for (int i = 0; i < 4; ++i) {
+    s[i] = splitmix64(x);
+  }
+}
+
+void
+Rng::fill_below(uint32_t n, int* out, size_t count) {
+  size_t i = 0;
+  for (; i + 1 < count; i += 2) {
+    const uint64_t x = (*this)();
+    out[i] = bounded(x >> 32, n);
+    out[i + 1] = bounded((uint32_t)x, n);
+  }
+  if (i < count) {
+    out[i] = below(n);
+  }
+}
+
+void
+Rng::fill_bernoulli(uint64_t threshold, uint64_t* bits, size_t count) {
+  const size_t words = (count + 63) / 64;
+  for (size_t w = 0; w < words; ++w) {
+    const size_t n = std::min<size_t>(64, count - w * 64);
+    uint64_t word = 0;
+    for (size_t b = 0; b < n; b += 2) {
+      const uint64_t x = (*this)();
+      word |= (uint64_t)((x >> 32) < threshold) << b;
+      if (b + 1 < n) {
+        word |= (uint64_t)((uint32_t)x < threshold) << (b + 1);
+      }
+    }
+    bits[w] = word;
+  }
+}
+
+uint64_t
+Rng::threshold(double p) {
+  if (!(p > 0)) return 0;
+  if (p >= 1) return 1ULL << 32;
+  return (uint64_t)(p * 4294967296.0);
+}
+
+uint64_t
+Rng::base_seed() {
+  static const uint64_t seed = []() {
+    const char* env = getenv("PUNTER_SEED");
+    return env ? strtoull(env, nullptr, 10) : 0ULL;
+  }();
+  return seed;
+}
+
+Rng&
+Rng::local() {
+  static std::atomic<uint64_t> num_threads(0);
+  thread_local Rng rng(base_seed(), num_threads++);
+  return rng;
+}
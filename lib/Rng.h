@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+/*
+ *  Pseudo-random numbers for the Monte Carlo code (xoshiro256**).
+ *
+ *  A generator is 32 bytes and is seeded explicitly with (seed, stream):
+ *  splitmix64 spreads the pair over the state, so the streams of one seed
+ *  (one per sample, per worker, ...) are unrelated.  There is no global
+ *  state; local() is the generator of the calling thread, seeded from
+ *  base_seed() (PUNTER_SEED, or 0), so a run is reproducible unless
+ *  PUNTER_SEED changes.
+ *
+ *  below(n) is Lemire's multiply-and-shift with rejection, exactly uniform
+ *  and without a division in the common case.  The fill_ helpers split
+ *  every 64-bit output into two 32-bit draws.  Being a
+ *  UniformRandomBitGenerator, a generator also works with <random> and
+ *  std::shuffle.
+ */
+
+class Rng {
+  uint64_t s[4];
+
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+  // uniform in [0, n) from the 32-bit draw |x|, drawing again on rejection
+  uint32_t bounded(uint32_t x, uint32_t n) {
+    uint64_t m = (uint64_t)x * n;
+    if ((uint32_t)m < n) {
+      const uint32_t t = -n % n;
+      while ((uint32_t)m < t) {
+        m = (uint64_t)(uint32_t)((*this)() >> 32) * n;
+      }
+    }
+    return m >> 32;
+  }
+public:
+  typedef uint64_t result_type;
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return UINT64_MAX; }
+
+  explicit Rng(uint64_t seed = 0, uint64_t stream = 0) { this->seed(seed, stream); }
+  void seed(uint64_t seed, uint64_t stream = 0);
+
+  result_type operator()() {
+    const uint64_t result = rotl(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  }
+
+  // uniform in [0, n), n > 0
+  uint32_t below(uint32_t n) { return bounded((*this)() >> 32, n); }
+  // uniform in [0, 1)
+  double uniform() { return ((*this)() >> 11) * (1.0 / 9007199254740992.0); }
+
+  // out[i] = below(n) for i < count
+  void fill_below(uint32_t n, int* out, size_t count);
+  // sets bit i of bits[i / 64] with probability threshold / 2^32 for
+  // i < count, and clears the rest of the last word
+  void fill_bernoulli(uint64_t threshold, uint64_t* bits, size_t count);
+  // probability p as a threshold of fill_bernoulli, clamped to [0, 1]
+  static uint64_t threshold(double p);
+
+  // Fisher-Yates with below()
+  template<class It>
+  void shuffle(It first, It last) {
+    for (auto i = std::distance(first, last) - 1; i > 0; --i) {
+      std::iter_swap(first + i, first + below(i + 1));
+    }
+  }
+
+  // PUNTER_SEED, or 0
+  static uint64_t base_seed();
+  // the generator of the calling thread, seeded with (base_seed(), n) for
+  // the n-th thread to ask for one; the main thread asks first
+  static Rng& local();
+};
@@ -0,0 +1,143 @@
+#include "StateCodec.h"
+
+namespace {
+  const char* BASE64_CHARS =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  int base64_value(char c) {
+    if ('A' <= c && c <= 'Z') return c - 'A';
+    if ('a' <= c && c <= 'z') return c - 'a' + 26;
+    if ('0' <= c && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+  }
+}
+
+namespace state_codec {
+
+void
+Writer::put_varint(uint64_t x) {
+  while (x >= 0x80) {
+    buf.push_back((char)((x & 0x7f) | 0x80));
+    x >>= 7;
+  }
+  buf.push_back((char)x);
+}
+
+void
+Writer::put_int(int64_t x) {
+  put_varint(((uint64_t)x << 1) ^ (uint64_t)(x >> 63));
+}
+
+void
+Writer::put_string(const std::string& s) {
+  put_varint(s.size());
+  buf += s;
+}
+
+uint8_t
+Reader::get_byte() {
+  if (cur == end) {
+    ok = false;
+    return 0;
+  }
+  return *cur++;
+}
+
+uint64_t
+Reader::get_varint() {
+  uint64_t x = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (cur == end) {
+      ok = false;
+      return 0;
+    }
+    const uint8_t b = *cur++;
+    x |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      return x;
+    }
+  }
+  ok = false;
+  return 0;
+}
+
+int64_t
+Reader::get_int() {
+  const uint64_t x = get_varint();
+  return (int64_t)(x >> 1) ^ -(int64_t)(x & 1);
+}
+
+std::string
+Reader::get_string() {
+  const uint64_t n = get_varint();
+  if (n > (uint64_t)(end - cur)) {
+    ok = false;
+    return std::string();
+  }
+  const std::string s((const char*)cur, n);
+  cur += n;
+  return s;
+}
+
+size_t
+Reader::get_count(uint64_t limit) {
+  const uint64_t n = get_varint();
+  if (n > limit || n > (uint64_t)(end - cur)) {
+    ok = false;
+    return 0;
+  }
+  return n;
+}
+
+std::string
+base64_encode(const std::string& data) {
+  std::string res;
+  res.reserve((data.size() + 2) / 3 * 4);
+  const uint8_t* p = (const uint8_t*)data.data();
+  const size_t n = data.size();
+  size_t i = 0;
+  for (; i + 3 <= n; i += 3) {
+    const uint32_t w = (p[i] << 16) | (p[i + 1] << 8) | p[i + 2];
+    res.push_back(BASE64_CHARS[(w >> 18) & 63]);
+    res.push_back(BASE64_CHARS[(w >> 12) & 63]);
+    res.push_back(BASE64_CHARS[(w >> 6) & 63]);
+    res.push_back(BASE64_CHARS[w & 63]);
+  }
+  if (i + 1 == n) {
+    const uint32_t w = p[i] << 16;
+    res.push_back(BASE64_CHARS[(w >> 18) & 63]);
+    res.push_back(BASE64_CHARS[(w >> 12) & 63]);
+    res += "==";
+  } else if (i + 2 == n) {
+    const uint32_t w = (p[i] << 16) | (p[i + 1] << 8);
+    res.push_back(BASE64_CHARS[(w >> 18) & 63]);
+    res.push_back(BASE64_CHARS[(w >> 12) & 63]);
+    res.push_back(BASE64_CHARS[(w >> 6) & 63]);
+    res.push_back('=');
+  }
+  return res;
+}
+
+bool
+base64_decode(const std::string& text, std::string& data) {
+  data.clear();
+  data.reserve(text.size() / 4 * 3);
+  uint32_t w = 0;
+  int bits = 0;
+  for (const char c : text) {
+    if (c == '=') break;
+    const int v = base64_value(c);
+    if (v < 0) return false;
+    w = (w << 6) | v;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      data.push_back((char)((w >> bits) & 0xff));
+    }
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ *  Compact binary encoding used for the offline-mode state.
+ *
+ *  Integers are stored as LEB128 varints (signed values are zigzag-encoded)
+ *  and the whole blob is base64-wrapped so that it can be embedded in the
+ *  JSON protocol as a plain string.
+ */
+
+namespace state_codec {
+
+// state layouts
+const int FORMAT_EMBEDDED_MAP = 1;  // topology and ownership in the blob
+const int FORMAT_CACHED_MAP = 2;    // map hash and the move log only
+
+class Writer {
+  std::string buf;
+public:
+  void put_byte(uint8_t b) { buf.push_back((char)b); }
+  void put_varint(uint64_t x);
+  void put_int(int64_t x);  // zigzag
+  void put_bool(bool b) { put_byte(b ? 1 : 0); }
+  void put_string(const std::string& s);  // length, then the bytes
+
+  const std::string& data() const { return buf; }
+  void reserve(size_t n) { buf.reserve(n); }
+};
+
+class Reader {
+  const uint8_t* cur;
+  const uint8_t* end;
+  bool ok;
+public:
+  Reader(const std::string& data)
+    : cur((const uint8_t*)data.data()), end(cur + data.size()), ok(true) {}
+
+  uint8_t get_byte();
+  uint64_t get_varint();
+  int64_t get_int();  // zigzag
+  bool get_bool() { return get_byte() != 0; }
+  std::string get_string();
+  // a varint count of elements that take at least one byte each; fails
+  // (and gives 0) above |limit| or above the bytes left, so a corrupt count
+  // never turns into a huge allocation
+  size_t get_count(uint64_t limit);
+
+  // false if the blob was truncated or malformed
+  bool good() const { return ok; }
+  bool at_end() const { return cur == end; }
+};
+
+std::string base64_encode(const std::string& data);
+bool base64_decode(const std::string& text, std::string& data);
+
+}
@@ -0,0 +1,111 @@
+#include "ThreadPool.h"
+
+#include <cstdlib>
+#include <unistd.h>
+
+namespace {
+
+// set on the pool's threads and while a body runs on the caller
+thread_local bool inside_pool = false;
+
+}
+
+ThreadPool::ThreadPool(int num_threads)
+  : num_threads(num_threads < 1 ? 1 : num_threads), job(nullptr), job_size(0),
+    next_index(0), generation(0), busy(0), stopping(false) {
+  for (int worker = 1; worker < this->num_threads; ++worker) {
+    workers.emplace_back(&ThreadPool::work, this, worker);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& t : workers) {
+    t.join();
+  }
+}
+
+void
+ThreadPool::run_job(int worker) {
+  for (int i = next_index++; i < job_size; i = next_index++) {
+    (*job)(i, worker);
+  }
+}
+
+void
+ThreadPool::work(int worker) {
+  inside_pool = true;
+  uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&]() { return stopping || generation != seen; });
+      if (stopping) {
+        return;
+      }
+      seen = generation;
+    }
+    run_job(worker);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--busy == 0) {
+        finished.notify_one();
+      }
+    }
+  }
+}
+
+void
+ThreadPool::parallel_for(int n, const std::function<void(int, int)>& body) {
+  if (workers.empty() || inside_pool || n <= 1) {
+    for (int i = 0; i < n; ++i) {
+      body(i, 0);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    job = &body;
+    job_size = n;
+    next_index = 0;
+    busy = workers.size();
+    ++generation;
+  }
+  wake.notify_all();
+
+  inside_pool = true;
+  run_job(0);
+  inside_pool = false;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [this]() { return busy == 0; });
+  job = nullptr;
+}
+
+int
+ThreadPool::default_threads() {
+  const char* env = getenv("PUNTER_THREADS");
+  if (env && atoi(env) > 0) {
+    return atoi(env);
+  }
+  const int cores = std::thread::hardware_concurrency();
+  return cores > 0 ? cores : 1;
+}
+
+ThreadPool&
+ThreadPool::shared() {
+  static ThreadPool* pool = nullptr;
+  static pid_t owner = 0;
+  if (!pool || owner != getpid()) {
+    // the workers of a pool created before a fork do not exist in the
+    // child; that pool is abandoned rather than joined
+    pool = new ThreadPool(default_threads());
+    owner = getpid();
+  }
+  return *pool;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ *  Fixed set of worker threads for the heavy precomputations (mine BFS,
+ *  sampling at setup) and the MCTS search.
+ *
+ *  parallel_for(n, body) runs body(index, worker) for every index in
+ *  [0, n) and returns when all of them are done; the calling thread takes
+ *  part as worker 0.  Indices are handed out one by one, so a body must
+ *  write only to storage of its index (or of its worker, combined in a
+ *  fixed order afterwards) for the result not to depend on the number of
+ *  threads.
+ *
+ *  The size comes from PUNTER_THREADS and defaults to the number of cores;
+ *  with one thread, and inside a body, everything runs inline.
+ */
+
+class ThreadPool {
+  int num_threads;
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  const std::function<void(int, int)>* job;
+  int job_size;
+  std::atomic<int> next_index;
+  uint64_t generation;
+  int busy;       // workers still on the current job
+  bool stopping;
+
+  void work(int worker);
+  void run_job(int worker);
+public:
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  int size() const { return num_threads; }
+  void parallel_for(int n, const std::function<void(int index, int worker)>& body);
+
+  // PUNTER_THREADS, or the number of cores
+  static int default_threads();
+  // the pool of this process, started on first use (so that a zygote
+  // child, which does not inherit the parent's threads, gets its own)
+  static ThreadPool& shared();
+};
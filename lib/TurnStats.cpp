@@ -0,0 +1,74 @@
+#include "TurnStats.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+  const char* PHASE_NAMES[turn_stats::NUM_PHASES] = {
+    "read", "decode", "shortest_distances", "move", "encode", "write",
+  };
+  const char* COUNTER_NAMES[turn_stats::NUM_COUNTERS] = {
+    "evaluate", "bfs", "gains",
+  };
+
+  std::chrono::steady_clock::time_point turn_start = std::chrono::steady_clock::now();
+
+  double to_ms(int64_t ns) {
+    return ns / 1e6;
+  }
+}
+
+namespace turn_stats {
+
+std::atomic<int64_t> phase_ns[NUM_PHASES];
+std::atomic<int64_t> counters[NUM_COUNTERS];
+
+bool
+enabled() {
+  static const bool on = getenv("PUNTER_STATS") != nullptr;
+  return on;
+}
+
+void
+begin_turn() {
+  for (auto& t : phase_ns) {
+    t.store(0, std::memory_order_relaxed);
+  }
+  for (auto& c : counters) {
+    c.store(0, std::memory_order_relaxed);
+  }
+  turn_start = std::chrono::steady_clock::now();
+}
+
+void
+emit(Json::Value context) {
+  if (!enabled()) {
+    return;
+  }
+  const auto total = std::chrono::steady_clock::now() - turn_start;
+  Json::Value& times = context["time_ms"];
+  for (int i = 0; i < NUM_PHASES; ++i) {
+    times[PHASE_NAMES[i]] = to_ms(phase_ns[i].load(std::memory_order_relaxed));
+  }
+  times["total"] = to_ms(std::chrono::duration_cast<std::chrono::nanoseconds>(total).count());
+  Json::Value& counts = context["counts"];
+  for (int i = 0; i < NUM_COUNTERS; ++i) {
+    counts[COUNTER_NAMES[i]] = (Json::Int64)counters[i].load(std::memory_order_relaxed);
+  }
+
+  // a single fwrite per line, so that concurrent punters appending to the
+  // same file do not interleave
+  const std::string line = Json::FastWriter().write(context);
+  const char* dest = getenv("PUNTER_STATS");
+  if (strcmp(dest, "1") == 0) {
+    fwrite(line.data(), 1, line.size(), stderr);
+    fflush(stderr);
+  } else if (FILE* fp = fopen(dest, "a")) {
+    fwrite(line.data(), 1, line.size(), fp);
+    fclose(fp);
+  }
+}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "json/json.h"
+
+/*
+ *  Lightweight per-turn instrumentation.
+ *
+ *  Phases are timed with scoped timers and accumulate over one turn; they
+ *  may nest (e.g. shortest_distances inside decode for an embedded map, or
+ *  inside move when an AI calls it).  Counters record how often the hot
+ *  graph routines ran.
+ *
+ *  With PUNTER_STATS set, Game::run emits one JSON line per turn:
+ *    PUNTER_STATS=1      to stderr
+ *    PUNTER_STATS=<path> appended to the file
+ *  server/turn_stats.py aggregates these lines from the server logs.
+ */
+
+namespace turn_stats {
+
+enum Phase {
+  READ,                // receive and parse the message
+  DECODE,              // decode_state
+  SHORTEST_DISTANCES,  // Graph::calc_shortest_distances
+  MOVE,                // setup() / move()
+  ENCODE,              // encode_state
+  WRITE,               // write the reply
+  NUM_PHASES,
+};
+
+enum Counter {
+  EVALUATE,  // full scorings: Graph::evaluate and its CSR / playout counterparts
+  BFS,       // single-source searches over the graph
+  GAINS,     // punters whose river gains Graph::marginal_gains / best_gains computed
+  NUM_COUNTERS,
+};
+
+extern std::atomic<int64_t> phase_ns[NUM_PHASES];
+extern std::atomic<int64_t> counters[NUM_COUNTERS];
+
+inline void count(Counter counter, int64_t n = 1) {
+  counters[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+class ScopedTimer {
+  Phase phase;
+  bool running;
+  std::chrono::steady_clock::time_point start;
+public:
+  explicit ScopedTimer(Phase phase)
+    : phase(phase), running(true), start(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer() { stop(); }
+
+  // ends the measurement before the end of the scope
+  void stop() {
+    if (!running) {
+      return;
+    }
+    running = false;
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    phase_ns[phase].fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+      std::memory_order_relaxed);
+  }
+};
+
+// false unless PUNTER_STATS is set
+bool enabled();
+
+// clears the timers and counters and starts the turn clock
+void begin_turn();
+
+// writes |context| plus the phase times [ms] and counters as one line
+void emit(Json::Value context);
+
+}
@@ -0,0 +1,57 @@
+#include "Watchdog.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <unistd.h>
+
+void
+Watchdog::arm(std::chrono::steady_clock::time_point deadline, int fd, bool exit_after,
+              const std::function<std::string()>& fallback, const std::function<void()>& before_exit) {
+  disarm();
+  this->fallback = fallback;
+  this->before_exit = before_exit;
+  armed = true;
+  thread = std::thread(&Watchdog::watch, this, deadline, fd, exit_after);
+}
+
+bool
+Watchdog::disarm() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    armed = false;
+  }
+  cond.notify_one();
+  if (thread.joinable()) {
+    thread.join();
+  }
+  return has_fired.exchange(false);
+}
+
+void
+Watchdog::watch(std::chrono::steady_clock::time_point deadline, int fd, bool exit_after) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (cond.wait_until(lock, deadline, [this]() { return !armed; })) {
+    return;
+  }
+
+  fprintf(stderr, "watchdog: deadline expired, sending the best move so far\n");
+  const std::string message = fallback();
+  const char* p = message.data();
+  size_t remaining = message.size();
+  while (remaining > 0) {
+    const ssize_t written = ::write(fd, p, remaining);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      break;
+    }
+    p += written;
+    remaining -= written;
+  }
+  has_fired = true;
+  if (exit_after) {
+    before_exit();
+    _exit(0);
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+ *  Sends a fallback reply when a turn misses its deadline.
+ *
+ *  Game arms the watchdog around move().  If move() has not returned by
+ *  the deadline, the watchdog asks for the reply of the best move
+ *  registered so far (initially a pass), writes it itself and, for the one
+ *  process per turn modes, calls |before_exit| and terminates the process
+ *  with _exit(0).  The reply is only built when it is needed.
+ */
+
+class Watchdog {
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::thread thread;
+  std::function<std::string()> fallback;  // "<length>:<payload>"
+  std::function<void()> before_exit;
+  bool armed;
+  std::atomic<bool> has_fired;
+
+  void watch(std::chrono::steady_clock::time_point deadline, int fd, bool exit_after);
+public:
+  Watchdog() : armed(false), has_fired(false) {}
+  ~Watchdog() { disarm(); }
+
+  void arm(std::chrono::steady_clock::time_point deadline, int fd, bool exit_after,
+           const std::function<std::string()>& fallback, const std::function<void()>& before_exit);
+  // the fallback of the current arming has been sent
+  bool fired() const { return has_fired.load(); }
+  // stops watching; true if the fallback has already been sent
+  bool disarm();
+};
@@ -0,0 +1,98 @@
+#include "Zygote.h"
+#include "Protocol.h"
+
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+namespace {
+  // a client that stops sending must not block the parent forever
+  const int RECEIVE_TIMEOUT_SEC = 5;
+
+  int listen_unix(const char* path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+      return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return -1;
+    }
+    unlink(path);
+    if (bind(fd, (const sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  // handshake and turn message of one connection
+  bool receive_turn(int conn, const std::string& name, std::string& message) {
+    protocol::Writer out;
+    out.begin_object();
+    out.key("me").string(name);
+    out.end_object();
+    if (!out.flush(conn)) {
+      return false;
+    }
+
+    protocol::Reader reader(conn);
+    const char* payload;
+    size_t length;
+    if (!reader.next(payload, length) || !reader.next(payload, length)) {
+      return false;
+    }
+    message.assign(payload, length);
+    return true;
+  }
+}
+
+namespace zygote {
+
+bool
+serve(const char* path, const std::string& name,
+      const std::function<void(const std::string& message)>& warm_up,
+      int& conn, std::string& message) {
+  const int listen_fd = listen_unix(path);
+  if (listen_fd < 0) {
+    perror(path);
+    return false;
+  }
+  // children are reaped automatically, and a vanished client must not
+  // kill the parent
+  signal(SIGCHLD, SIG_IGN);
+  signal(SIGPIPE, SIG_IGN);
+
+  while (true) {
+    conn = accept(listen_fd, nullptr, nullptr);
+    if (conn < 0) {
+      continue;
+    }
+    timeval timeout = { RECEIVE_TIMEOUT_SEC, 0 };
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    if (receive_turn(conn, name, message)) {
+      warm_up(message);
+      const pid_t pid = fork();
+      if (pid == 0) {
+        close(listen_fd);
+        signal(SIGCHLD, SIG_DFL);
+        return true;
+      }
+      if (pid < 0) {
+        perror("fork");
+      }
+    }
+    close(conn);
+  }
+}
+
+}
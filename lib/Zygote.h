@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <functional>
+
+/*
+ *  Fork server for offline-mode turns.
+ *
+ *  With PUNTER_ZYGOTE=<socket path> an AI binary stays resident and
+ *  listens on a Unix socket instead of handling stdin.  Every connection
+ *  is one turn: the parent writes the handshake, reads the "you" reply and
+ *  the turn message, warms up for that message (e.g. preloads the cached
+ *  map) and forks.  The child handles the message and replies on the
+ *  connection, so it starts with the binary loaded, static initialization
+ *  done and the map decoded.
+ *
+ *  bin/lib/zygote_client forwards its stdin / stdout to such a socket and
+ *  stands in for the AI binary in the one process per turn contract.
+ */
+
+namespace zygote {
+
+// Returns only in a forked child, with the connection and the message of
+// its turn, or false when the socket cannot be set up.
+bool serve(const char* path, const std::string& name,
+           const std::function<void(const std::string& message)>& warm_up,
+           int& conn, std::string& message);
+
+}
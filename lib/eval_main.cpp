@@ -12,9 +12,8 @@ int main() {
   const Json::Value graph_json = input["map"];
 
   Graph graph;
-  std::vector<int> reverse_id_map;
-  std::map<int, int> id_map;
-  std::tie(graph, reverse_id_map, id_map) = Graph::from_json_setup(graph_json);
+  IdMap id_map;
+  std::tie(graph, id_map) = Graph::from_json_setup(graph_json);
 
   std::map<std::pair<int, int>, int> owned_by, options;
   const Json::Value rivers = graph_json["rivers"];
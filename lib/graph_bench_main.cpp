@@ -0,0 +1,136 @@
+#include "Game.h"
+#include "CsrGraph.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+
+#include "json/json.h"
+
+// Compares the adjacency-list Graph with CsrGraph: mine BFS
+// (calc_shortest_distances per mine, bit-parallel and auto), evaluate
+// (on distance vectors and on a DistanceTable) and claim throughput on a
+// map where half of the rivers are claimed.
+//
+// $ ./bin/lib/graph_bench maps/tube.json maps/oxford-3000-nodes.json ...
+
+namespace {
+
+const int NUM_PUNTERS = 4;
+const double MIN_BENCH_MS = 200;
+
+// runs |f| until MIN_BENCH_MS has passed and prints the time per call
+template<class F>
+void measure(const char* map_name, const char* op, const char* layout, int items, F f) {
+  f();  // warm up
+  int repeat = 0;
+  auto start = std::chrono::steady_clock::now();
+  double ms = 0;
+  do {
+    f();
+    ++repeat;
+    ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  } while (ms < MIN_BENCH_MS);
+  ms /= repeat;
+  printf("%-36s %-10s %-6s %10.4f %14.0f\n", map_name, op, layout, ms, items * 1000.0 / ms);
+}
+
+void bench_map(const char* path) {
+  std::ifstream ifs(path);
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  Json::Value map;
+  if (!Json::Reader().parse(ss.str(), map) || !map.isMember("rivers")) {
+    return;
+  }
+
+  Graph graph;
+  IdMap id_map;
+  std::tie(graph, id_map) = Graph::from_json_setup(map);
+
+  std::vector<std::pair<int, int>> rivers;
+  for (int u = 0; u < graph.num_vertices; ++u) {
+    for (const auto& river : graph.rivers[u]) {
+      if (u < river.to) {
+        rivers.emplace_back(u, river.to);
+      }
+    }
+  }
+  std::mt19937 rng(0);
+  std::shuffle(rivers.begin(), rivers.end(), rng);
+  for (size_t i = 0; i < rivers.size() / 2; ++i) {
+    const int punter = i % NUM_PUNTERS;
+    graph.find_river(rivers[i].first, rivers[i].second).punter = punter;
+    graph.find_river(rivers[i].second, rivers[i].first).punter = punter;
+  }
+  const CsrGraph csr = CsrGraph::from_graph(graph);
+
+  const auto distances = graph.calc_shortest_distances(Graph::DistanceMethod::PER_MINE);
+  if (csr.calc_shortest_distances() != distances
+      || graph.calc_shortest_distances(Graph::DistanceMethod::BIT_PARALLEL) != distances
+      || graph.calc_shortest_distances(Graph::DistanceMethod::AUTO) != distances
+      || csr.evaluate(NUM_PUNTERS, distances) != graph.evaluate(NUM_PUNTERS, distances)) {
+    printf("%-36s results differ\n", path);
+    return;
+  }
+
+  measure(path, "bfs", "graph", graph.num_mines, [&]() {
+    graph.calc_shortest_distances(Graph::DistanceMethod::PER_MINE);
+  });
+  measure(path, "bfs", "bits", graph.num_mines, [&]() {
+    graph.calc_shortest_distances(Graph::DistanceMethod::BIT_PARALLEL);
+  });
+  measure(path, "bfs", "auto", graph.num_mines, [&]() {
+    graph.calc_shortest_distances(Graph::DistanceMethod::AUTO);
+  });
+  measure(path, "bfs", "csr", graph.num_mines, [&]() {
+    csr.calc_shortest_distances();
+  });
+  measure(path, "evaluate", "graph", 1, [&]() {
+    graph.evaluate(NUM_PUNTERS, distances);
+  });
+  measure(path, "evaluate", "csr", 1, [&]() {
+    csr.evaluate(NUM_PUNTERS, distances);
+  });
+  const DistanceTable table(distances);
+  measure(path, "evaluate", "table", 1, [&]() {
+    graph.evaluate(NUM_PUNTERS, table);
+  });
+  int64_t dummy;
+  measure(path, "evaluate", "csr+t", 1, [&]() {
+    csr.evaluate(csr.ownership, NUM_PUNTERS, table, -1, {}, dummy);
+  });
+
+  // claim every river by its endpoints, then release it again
+  Graph claim_graph = graph;
+  measure(path, "claim", "graph", 2 * rivers.size(), [&]() {
+    for (int punter : {0, -1}) {
+      for (const auto& r : rivers) {
+        claim_graph.find_river(r.first, r.second).punter = punter;
+        claim_graph.find_river(r.second, r.first).punter = punter;
+      }
+    }
+  });
+  CsrGraph claim_csr = csr;
+  measure(path, "claim", "csr", 2 * rivers.size(), [&]() {
+    for (int punter : {0, -1}) {
+      for (const auto& r : rivers) {
+        claim_csr.claim(claim_csr.edge(r.first, r.second), punter);
+      }
+    }
+  });
+}
+
+}
+
+int main(int argc, char** argv) {
+  printf("%-36s %-10s %-6s %10s %14s\n", "map", "op", "layout", "time[ms]", "items/s");
+  for (int i = 1; i < argc; ++i) {
+    bench_map(argv[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,116 @@
+#include "Game.h"
+#include "CsrGraph.h"
+#include "IncrementalScorer.h"
+#include "Rng.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+
+#include "json/json.h"
+
+// Random playouts as MCTS_Core runs them (every free river to a random
+// punter, from a map where a quarter of the rivers are claimed), with 2
+// and 4 punters, scored with CsrGraph::evaluate and with IncrementalScorer::playout.
+// Checks that both give the same scores and futures score, and prints the
+// playouts per second of each.
+//
+// $ ./bin/lib/playout_bench maps/tube.json maps/oxford-3000-nodes.json ...
+
+namespace {
+
+const int NUM_CHECKS = 100;
+const double MIN_BENCH_MS = 200;
+
+// runs |f| until MIN_BENCH_MS has passed and prints the time per call
+template<class F>
+void measure(const char* map_name, int num_punters, const char* scorer, F f) {
+  f();  // warm up
+  int repeat = 0;
+  auto start = std::chrono::steady_clock::now();
+  double ms = 0;
+  do {
+    f();
+    ++repeat;
+    ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  } while (ms < MIN_BENCH_MS);
+  ms /= repeat;
+  printf("%-36s %7d %-10s %10.4f %14.0f\n", map_name, num_punters, scorer, ms, 1000.0 / ms);
+}
+
+void bench_map(const char* path, int num_punters) {
+  std::ifstream ifs(path);
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  Json::Value map;
+  if (!Json::Reader().parse(ss.str(), map) || !map.isMember("rivers")) {
+    return;
+  }
+
+  Graph graph;
+  IdMap id_map;
+  std::tie(graph, id_map) = Graph::from_json_setup(map);
+  CsrGraph csr = CsrGraph::from_graph(graph);
+  const DistanceTable table(graph.calc_shortest_distances());
+
+  Rng rng(0);
+  std::vector<int> edges(csr.num_edges);
+  for (int e = 0; e < csr.num_edges; ++e) {
+    edges[e] = e;
+  }
+  rng.shuffle(edges.begin(), edges.end());
+  const size_t claimed = edges.size() / 4;
+  for (size_t i = 0; i < claimed; ++i) {
+    csr.claim(edges[i], i % num_punters);
+  }
+  const std::vector<int> free_edges(edges.begin() + claimed, edges.end());
+  std::vector<int> futures(csr.num_mines, -1);
+  for (int m = 0; m < csr.num_mines; m += 2) {
+    futures[m] = rng.below(csr.num_vertices);
+  }
+
+  OwnershipTable own = csr.ownership;
+  IncrementalScorer scorer(num_punters, table);
+  scorer.load(csr, csr.ownership);
+  int64_t future_score, scorer_future_score;
+  std::vector<int> draws(free_edges.size());
+
+  // one playout, scored by CsrGraph::evaluate or else by the scorer
+  auto playout = [&](bool evaluate) {
+    own.restore(csr.ownership);
+    rng.fill_below(num_punters, draws.data(), draws.size());
+    for (size_t i = 0; i < free_edges.size(); ++i) {
+      own.set_punter(free_edges[i], draws[i]);
+    }
+    return evaluate ? csr.evaluate(own, num_punters, table, 0, futures, future_score)
+                    : scorer.playout(own, 0, futures, scorer_future_score);
+  };
+
+  for (int i = 0; i < NUM_CHECKS; ++i) {
+    const Rng saved = rng;
+    const auto expected = playout(true);
+    rng = saved;
+    if (playout(false) != expected || scorer_future_score != future_score) {
+      printf("%-36s results differ\n", path);
+      return;
+    }
+  }
+
+  measure(path, num_punters, "evaluate", [&]() { playout(true); });
+  measure(path, num_punters, "union-find", [&]() { playout(false); });
+}
+
+}
+
+int main(int argc, char** argv) {
+  printf("%-36s %7s %-10s %10s %14s\n", "map", "punters", "scorer", "time[ms]", "playouts/s");
+  for (int i = 1; i < argc; ++i) {
+    for (const int num_punters : {2, 4}) {
+      bench_map(argv[i], num_punters);
+    }
+  }
+  return 0;
+}
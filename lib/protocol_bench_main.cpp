@@ -0,0 +1,193 @@
+#include "Game.h"
+#include "Protocol.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "json/json.h"
+
+// Compares the DOM path (Json::Reader / Json::FastWriter) with the streaming
+// protocol reader and writer: time and heap allocations per message.
+//
+// $ ./bin/lib/protocol_bench maps/tube.json maps/oxford-3000-nodes.json ...
+
+namespace {
+  size_t num_allocs = 0;
+}
+
+void* operator new(size_t size) {
+  ++num_allocs;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+
+namespace {
+
+class BenchAI : public Game {
+public:
+  SetupSettings setup() const override {
+    return SetupSettings(Json::Value());
+  }
+
+  MoveResult move() const override {
+    return MoveResult(Json::Value());
+  }
+
+  std::string name() const override { return "protocol_bench"; }
+
+  using Game::binary_state;
+  using Game::handle_setup;
+  using Game::encode_state;
+  using Game::write_state;
+};
+
+const int NUM_PUNTERS = 4;
+const int REPEAT = 20;
+
+template<class F>
+void measure(const char* map_name, const char* message, const char* path, F f) {
+  f();  // warm up
+  const size_t allocs_before = num_allocs;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < REPEAT; ++i) {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  const double ms = std::chrono::duration<double, std::milli>(end - start).count() / REPEAT;
+  printf("%-36s %-12s %-10s %10.3f %10zu\n",
+         map_name, message, path, ms, (num_allocs - allocs_before) / REPEAT);
+}
+
+void bench_setup(const char* map_name, const std::string& text) {
+  measure(map_name, "setup", "dom", [&]() {
+    Json::Value json;
+    Json::Reader().parse(text.data(), text.data() + text.size(), json);
+    Graph graph;
+    IdMap id_map;
+    std::tie(graph, id_map) = Graph::from_json_setup(json["map"]);
+  });
+  measure(map_name, "setup", "stream", [&]() {
+    protocol::SetupMessage msg;
+    protocol::parse_setup(text.data(), text.size(), msg);
+    Graph graph;
+    IdMap id_map;
+    std::tie(graph, id_map) = Graph::from_setup(msg.sites, msg.mines, msg.rivers);
+  });
+}
+
+void bench_move(const char* map_name, const char* message, const std::string& text) {
+  measure(map_name, message, "dom", [&]() {
+    Json::Value json;
+    Json::Reader().parse(text.data(), text.data() + text.size(), json);
+    std::vector<int> ids;
+    for (const Json::Value& mv : json["move"]["moves"]) {
+      ids.push_back(mv["claim"]["source"].asInt());
+      ids.push_back(mv["claim"]["target"].asInt());
+    }
+    const Json::Value& state = json["state"];
+    if (state.isMember("blob")) {
+      const std::string blob = state["blob"].asString();
+    }
+  });
+  measure(map_name, message, "stream", [&]() {
+    protocol::MoveMessage msg;
+    protocol::parse_move(text.data(), text.size(), msg);
+  });
+}
+
+// the claim reply of a move turn, written to /dev/null
+void bench_reply(const char* map_name, const char* message, BenchAI& ai, const Json::Value& river) {
+  const int fd = open("/dev/null", O_WRONLY);
+  const Json::Value info;
+  measure(map_name, message, "dom", [&]() {
+    Json::Value res;
+    res["claim"]["punter"] = 0;
+    res["claim"]["source"] = river["source"];
+    res["claim"]["target"] = river["target"];
+    res["state"] = ai.encode_state(info);
+    const std::string json_str = Json::FastWriter().write(res);
+    const std::string msg = std::to_string(json_str.size()) + ":" + json_str;
+    (void)!write(fd, msg.data(), msg.size());
+  });
+  protocol::Writer out;
+  measure(map_name, message, "stream", [&]() {
+    out.begin_object();
+    out.key("claim").begin_object();
+    out.key("punter").integer(0);
+    out.key("source").integer(river["source"].asInt());
+    out.key("target").integer(river["target"].asInt());
+    out.end_object();
+    out.key("state");
+    ai.write_state(out, info);
+    out.end_object();
+    out.flush(fd);
+  });
+  close(fd);
+}
+
+void bench_map(const char* path) {
+  std::ifstream ifs(path);
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  Json::Value map;
+  if (!Json::Reader().parse(ss.str(), map) || !map.isMember("rivers")) {
+    return;
+  }
+
+  Json::Value setup;
+  setup["punter"] = 0;
+  setup["punters"] = NUM_PUNTERS;
+  setup["map"] = map;
+  setup["settings"]["futures"] = true;
+  setup["settings"]["options"] = true;
+  Json::FastWriter writer;
+  bench_setup(path, writer.write(setup));
+
+  for (int binary = 0; binary < 2; ++binary) {
+    BenchAI ai;
+    ai.binary_state = binary;
+    protocol::Writer out;
+    ai.handle_setup(setup, out);
+    Json::Value reply;
+    Json::Reader().parse(out.payload(), reply);
+    Json::Value msg;
+    msg["state"] = reply["state"];
+    Json::Value& moves = msg["move"]["moves"];
+    for (int p = 0; p < NUM_PUNTERS; ++p) {
+      Json::Value claim;
+      claim["claim"]["punter"] = p;
+      claim["claim"]["source"] = map["rivers"][p]["source"];
+      claim["claim"]["target"] = map["rivers"][p]["target"];
+      moves.append(claim);
+    }
+    bench_move(path, binary ? "move/binary" : "move/json", writer.write(msg));
+    bench_reply(path, binary ? "reply/binary" : "reply/json", ai, map["rivers"][0]);
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  printf("%-36s %-12s %-10s %10s %10s\n", "map", "message", "path", "time[ms]", "allocs");
+  for (int i = 1; i < argc; ++i) {
+    bench_map(argv[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,291 @@
+#include "Game.h"
+#include "IncrementalScorer.h"
+#include "CurrentDistances.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <deque>
+#include <cstdio>
+
+#include "json/json.h"
+
+// Differential check of IncrementalScorer, Graph::marginal_gains and the
+// DistanceTable evaluate against Graph::evaluate: plays a random game
+// (claims, options and tried-then-undone moves) on every map and compares
+// the scores and the futures score after each step.  Also checks
+// CurrentDistances, updated after every change, against a fresh build and
+// a plain 0-1 BFS, and Game::calc_cur_dists, whose calls after the first
+// repair their last result, against Game::calc_shortest_paths.  Reports
+// the time of one evaluate() and of one claim + undo.
+//
+// $ ./bin/lib/scorer_check maps/*.json
+
+namespace {
+
+const int NUM_PUNTERS = 4;
+const int MAX_CHECKS = 2000;
+
+// exposes the shortest paths of punter 0 of a Game
+class PathsAI : public Game {
+public:
+  SetupSettings setup() const override {
+    return SetupSettings(Json::Value());
+  }
+
+  MoveResult move() const override {
+    return MoveResult(Json::Value());
+  }
+
+  std::string name() const override { return "scorer_check"; }
+
+  void set_graph(const Graph& g) {
+    graph = g;
+    punter_id = 0;
+  }
+
+  using Game::calc_shortest_paths;
+  using Game::calc_cur_dists;
+};
+
+struct Checker {
+  Graph graph;
+  std::vector<std::vector<int>> distances;
+  DistanceTable table;
+  std::vector<int> futures;
+  std::vector<int> mines;
+  CurrentDistances paths;  // of punter 0, updated after every change
+  PathsAI ai;              // calc_cur_dists() on a copy of |graph|
+  int checks = 0;
+  int failures = 0;
+
+  void check(const IncrementalScorer& scorer, const char* what) {
+    ++checks;
+    int64_t future_score, table_future_score;
+    const auto expected = graph.evaluate(NUM_PUNTERS, distances, 0, futures, future_score);
+    if (expected != scorer.scores()
+        || future_score != scorer.future_score(0, futures)
+        || expected != graph.evaluate(NUM_PUNTERS, table, 0, futures, table_future_score)
+        || future_score != table_future_score) {
+      if (failures++ == 0) {
+        printf("  mismatch after %s (step %d)\n", what, checks);
+      }
+    }
+  }
+
+  void check_paths(const char* what) {
+    CurrentDistances fresh;
+    fresh.build(graph, 0, mines);
+    std::vector<int> dist, prev, fresh_dist, fresh_prev;
+    for (int m = 0; m < graph.num_mines; ++m) {
+      paths.copy_row(m, dist, prev, INF);
+      fresh.copy_row(m, fresh_dist, fresh_prev, INF);
+      if ((dist != fresh_dist || prev != fresh_prev || dist != reference_distances(m))
+          && failures++ == 0) {
+        printf("  mismatch of CurrentDistances after %s (step %d)\n", what, checks);
+      }
+    }
+  }
+
+  // calc_cur_dists() must give the distances of calc_shortest_paths(); its
+  // prevs may break ties differently but must still be cheapest paths
+  void check_cur_dists(const char* what) {
+    ai.set_graph(graph);
+    DistanceMatrix dists;
+    std::vector<std::vector<int>> prevs;
+    ai.calc_cur_dists(dists, prevs);
+    std::vector<int> dist, prev;
+    for (int m = 0; m < graph.num_mines; ++m) {
+      ai.calc_shortest_paths(m, dist, prev);
+      if ((dists.row_vector(m) != dist || !is_path_tree(m, dist, prevs[m]))
+          && failures++ == 0) {
+        printf("  mismatch of Game::calc_cur_dists after %s (step %d)\n", what, checks);
+      }
+    }
+  }
+
+  // every vertex reached from |src| comes from a neighbor through a river
+  // punter 0 can use at the cost of |dist|, and following prev leads to |src|
+  bool is_path_tree(int src, const std::vector<int>& dist, const std::vector<int>& prev) const {
+    std::vector<char> state(graph.num_vertices, 0);  // 1: on the walk, 2: leads to src
+    state[src] = 2;
+    if (prev[src] != -1) {
+      return false;
+    }
+    for (int v = 0; v < graph.num_vertices; ++v) {
+      if (v == src) continue;
+      const int p = prev[v];
+      if (p < 0) {
+        if (dist[v] <= graph.num_vertices) return false;  // reached
+        continue;
+      }
+      const auto& rs = graph.rivers[v];
+      const auto it = std::lower_bound(rs.begin(), rs.end(), Graph::River(p));
+      if (it == rs.end() || it->to != p || (it->punter != -1 && it->punter != 0)
+          || dist[p] + (it->punter == 0 ? 0 : 1) != dist[v]) {
+        return false;
+      }
+    }
+    for (int v = 0; v < graph.num_vertices; ++v) {
+      int u = v;
+      while (prev[u] >= 0 && state[u] == 0) {
+        state[u] = 1;
+        u = prev[u];
+      }
+      if (state[u] == 1) {
+        return false;  // a cycle
+      }
+      for (u = v; state[u] == 1; u = prev[u]) {
+        state[u] = 2;
+      }
+    }
+    return true;
+  }
+
+  // 0-1 BFS from |src| over the rivers of punter 0 (cost 0) and free ones
+  std::vector<int> reference_distances(int src) const {
+    std::vector<int> dist(graph.num_vertices, INF);
+    std::deque<int> que;
+    dist[src] = 0;
+    que.push_back(src);
+    while (!que.empty()) {
+      const int v = que.front();
+      que.pop_front();
+      for (const auto& river : graph.rivers[v]) {
+        if (river.punter != -1 && river.punter != 0) {
+          continue;
+        }
+        const int d = river.punter == 0 ? 0 : 1;
+        if (dist[river.to] > dist[v] + d) {
+          dist[river.to] = dist[v] + d;
+          d == 0 ? que.push_front(river.to) : que.push_back(river.to);
+        }
+      }
+    }
+    return dist;
+  }
+
+  static const int INF = 1 << 29;
+};
+
+bool check_map(const char* path) {
+  std::ifstream ifs(path);
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  Json::Value map;
+  if (!Json::Reader().parse(ss.str(), map) || !map.isMember("rivers")) {
+    return true;
+  }
+
+  Checker c;
+  IdMap id_map;
+  std::tie(c.graph, id_map) = Graph::from_json_setup(map);
+  c.distances = c.graph.calc_shortest_distances();
+  c.table = DistanceTable(c.distances);
+
+  std::mt19937 rng(0);
+  for (int m = 0; m < c.graph.num_mines; ++m) {
+    c.mines.push_back(m);
+  }
+  c.paths.build(c.graph, 0, c.mines);
+
+  c.futures.assign(c.graph.num_mines, -1);
+  for (int m = 0; m < c.graph.num_mines; m += 2) {
+    c.futures[m] = rng() % c.graph.num_vertices;
+  }
+
+  std::vector<std::pair<int, int>> rivers;
+  for (int u = 0; u < c.graph.num_vertices; ++u) {
+    for (const auto& river : c.graph.rivers[u]) {
+      if (u < river.to) {
+        rivers.emplace_back(u, river.to);
+      }
+    }
+  }
+  std::shuffle(rivers.begin(), rivers.end(), rng);
+
+  IncrementalScorer scorer(NUM_PUNTERS, c.table);
+  const int stride = std::max<int>(1, rivers.size() / MAX_CHECKS);
+  double evaluate_ms = 0, claim_ms = 0;
+  int timed = 0;
+
+  for (size_t i = 0; i < rivers.size(); ++i) {
+    const int u = rivers[i].first, v = rivers[i].second;
+    const int punter = rng() % NUM_PUNTERS;
+    const bool check = i % stride == 0;
+
+    // try the move, then take it back
+    if (check) {
+      const auto gains = c.graph.marginal_gains(punter, c.table);
+      const auto& rs = c.graph.rivers[u];
+      const int64_t gain = gains[u][std::lower_bound(rs.begin(), rs.end(), Graph::River(v)) - rs.begin()];
+      const int64_t before = scorer.score(punter);
+
+      auto start = std::chrono::steady_clock::now();
+      const size_t mark = scorer.history_size();
+      scorer.claim(u, v, punter);
+      const int64_t tried = scorer.score(punter);
+      scorer.undo_to(mark);
+      auto mid = std::chrono::steady_clock::now();
+      c.graph.find_river(u, v).punter = punter;
+      c.graph.find_river(v, u).punter = punter;
+      const int64_t expected = c.graph.evaluate(NUM_PUNTERS, c.distances, punter)[punter];
+      auto end = std::chrono::steady_clock::now();
+      claim_ms += std::chrono::duration<double, std::milli>(mid - start).count();
+      evaluate_ms += std::chrono::duration<double, std::milli>(end - mid).count();
+      ++timed;
+      c.paths.update(c.graph);
+      c.check_paths("a tried claim");
+      c.check_cur_dists("a tried claim");
+      c.graph.find_river(u, v).punter = -1;
+      c.graph.find_river(v, u).punter = -1;
+      c.paths.update(c.graph);
+      if (tried != expected && c.failures++ == 0) {
+        printf("  mismatch of a tried claim (step %d)\n", c.checks);
+      }
+      if (before + gain != expected && c.failures++ == 0) {
+        printf("  mismatch of Graph::marginal_gains (step %d)\n", c.checks);
+      }
+      c.check(scorer, "undo");
+    }
+
+    c.graph.find_river(u, v).punter = punter;
+    c.graph.find_river(v, u).punter = punter;
+    scorer.claim(u, v, punter);
+    c.paths.update(c.graph);
+    if (rng() % 4 == 0) {
+      const int buyer = (punter + 1 + rng() % (NUM_PUNTERS - 1)) % NUM_PUNTERS;
+      c.graph.find_river(u, v).option = buyer;
+      c.graph.find_river(v, u).option = buyer;
+      scorer.option(u, v, buyer);
+    }
+    if (check) {
+      c.check(scorer, "claim");
+      c.check_paths("claim");
+      c.check_cur_dists("claim");
+    }
+  }
+
+  // a scorer rebuilt from the final graph must agree as well
+  IncrementalScorer loaded(NUM_PUNTERS, c.table);
+  loaded.load(c.graph);
+  c.check(loaded, "load");
+
+  printf("%-36s %6d checks %s  evaluate %8.4f ms  claim+undo %8.4f ms\n",
+         path, c.checks, c.failures ? "FAIL" : "ok  ",
+         evaluate_ms / std::max(timed, 1), claim_ms / std::max(timed, 1));
+  return c.failures == 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+  bool ok = true;
+  for (int i = 1; i < argc; ++i) {
+    ok &= check_map(argv[i]);
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+#include "Game.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+
+#include "json/json.h"
+
+// Measures encode_state + decode_state time and state size for the
+// legacy JSON layout and the binary layouts (embedded map / map cache),
+// and checks that decoding each gives back the same game.
+//
+// $ ./bin/lib/state_bench maps/tube.json maps/oxford-3000-nodes.json ...
+
+namespace {
+
+class BenchAI : public Game {
+public:
+  SetupSettings setup() const override {
+    return SetupSettings(Json::Value());
+  }
+
+  MoveResult move() const override {
+    return MoveResult(Json::Value());
+  }
+
+  std::string name() const override { return "state_bench"; }
+
+  using Game::binary_state;
+  using Game::map_cached;
+  using Game::encode_state;
+  using Game::decode_state;
+  using Game::handle_setup;
+  using Game::handle_move;
+
+  // the whole game as its JSON state, which decoding either format must
+  // give back
+  std::string dump() {
+    const bool binary = binary_state;
+    binary_state = false;
+    const std::string res = Json::FastWriter().write(encode_state(Json::Value()));
+    binary_state = binary;
+    return res;
+  }
+};
+
+const int NUM_PUNTERS = 4;
+const int REPEAT = 20;
+
+enum Format { JSON, EMBEDDED, CACHED };
+const char* FORMAT_NAMES[] = { "json", "binary", "cached" };
+
+void measure(BenchAI& ai, const char* map_name, int claimed, Format format) {
+  ai.binary_state = format != JSON;
+  ai.map_cached = format == CACHED;
+  const Json::Value info;
+  Json::Value state = ai.encode_state(info);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < REPEAT; ++i) {
+    state = ai.encode_state(info);
+  }
+  auto mid = std::chrono::steady_clock::now();
+  const std::string before = ai.dump();
+  for (int i = 0; i < REPEAT; ++i) {
+    ai.decode_state(state);
+  }
+  auto end = std::chrono::steady_clock::now();
+  const bool same = before == ai.dump();
+
+  Json::FastWriter writer;
+  const size_t size = writer.write(state).size();
+  const double enc_ms = std::chrono::duration<double, std::milli>(mid - start).count() / REPEAT;
+  const double dec_ms = std::chrono::duration<double, std::milli>(end - mid).count() / REPEAT;
+  printf("%-36s %6d %-6s %10.3f %10.3f %10zu %s\n",
+         map_name, claimed, FORMAT_NAMES[format], enc_ms, dec_ms, size,
+         same ? "ok" : "MISMATCH");
+}
+
+Json::Value reply_state(protocol::Writer& out) {
+  Json::Value reply;
+  Json::Reader().parse(out.payload(), reply);
+  out.clear();
+  return reply["state"];
+}
+
+void bench_map(const char* path) {
+  std::ifstream ifs(path);
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  Json::Value map;
+  Json::Reader reader;
+  if (!reader.parse(ss.str(), map) || !map.isMember("rivers")) {
+    return;
+  }
+
+  BenchAI ai;
+  Json::Value setup;
+  setup["punter"] = 0;
+  setup["punters"] = NUM_PUNTERS;
+  setup["map"] = map;
+  setup["settings"]["futures"] = true;
+  setup["settings"]["options"] = true;
+  protocol::Writer out;
+  ai.handle_setup(setup, out);
+  Json::Value state = reply_state(out);
+
+  std::vector<Json::Value> rivers(map["rivers"].begin(), map["rivers"].end());
+  std::mt19937 mt(0);
+  std::shuffle(rivers.begin(), rivers.end(), mt);
+
+  const int num_rivers = rivers.size();
+  const int checkpoints[] = { 0, num_rivers / 2, num_rivers };
+  int next_checkpoint = 0;
+  int claimed = 0;
+  while (true) {
+    if (next_checkpoint < 3 && claimed >= checkpoints[next_checkpoint]) {
+      measure(ai, path, claimed, JSON);
+      measure(ai, path, claimed, EMBEDDED);
+      measure(ai, path, claimed, CACHED);
+      ++next_checkpoint;
+    }
+    if (claimed == num_rivers) break;
+
+    Json::Value msg;
+    Json::Value& moves = msg["move"]["moves"];
+    moves.resize(0);
+    Json::Value pass;
+    pass["pass"]["punter"] = 0;
+    moves.append(pass);
+    for (int p = 1; p < NUM_PUNTERS && claimed < num_rivers; ++p) {
+      Json::Value claim;
+      claim["claim"]["punter"] = p;
+      claim["claim"]["source"] = rivers[claimed]["source"];
+      claim["claim"]["target"] = rivers[claimed]["target"];
+      moves.append(claim);
+      ++claimed;
+    }
+    msg["state"] = state;
+    ai.handle_move(msg, out);
+    state = reply_state(out);
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  printf("%-36s %6s %-6s %10s %10s %10s\n",
+         "map", "claims", "format", "enc[ms]", "dec[ms]", "bytes");
+  for (int i = 1; i < argc; ++i) {
+    bench_map(argv[i]);
+  }
+  return 0;
+}
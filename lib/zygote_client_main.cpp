@@ -0,0 +1,92 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Stands in for an AI binary that runs as a zygote (see Zygote.h):
+// forwards stdin to the zygote socket and the reply back to stdout.
+//
+// $ PUNTER_ZYGOTE=/tmp/mcts.sock ./bin/MCTS &
+// $ ./bin/lib/zygote_client /tmp/mcts.sock < turn.txt
+//
+// Without an argument the socket path is taken from PUNTER_ZYGOTE_CLIENT.
+
+namespace {
+
+bool write_all(int fd, const char* p, size_t n) {
+  while (n > 0) {
+    const ssize_t w = write(fd, p, n);
+    if (w <= 0) {
+      return false;
+    }
+    p += w;
+    n -= w;
+  }
+  return true;
+}
+
+int connect_unix(const char* path) {
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+}
+
+int main(int argc, char** argv) {
+  const char* path = argc > 1 ? argv[1] : getenv("PUNTER_ZYGOTE_CLIENT");
+  if (!path) {
+    fprintf(stderr, "usage: %s <zygote socket>\n", argv[0]);
+    return 1;
+  }
+  const int sock = connect_unix(path);
+  if (sock < 0) {
+    perror(path);
+    return 1;
+  }
+
+  static char buf[1 << 16];
+  pollfd fds[2] = { { 0, POLLIN, 0 }, { sock, POLLIN, 0 } };
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      return 1;
+    }
+    if (fds[0].revents) {
+      const ssize_t n = read(0, buf, sizeof(buf));
+      if (n <= 0) {
+        shutdown(sock, SHUT_WR);
+        fds[0].fd = -1;
+      } else if (!write_all(sock, buf, n)) {
+        return 1;
+      }
+    }
+    if (fds[1].revents) {
+      const ssize_t n = read(sock, buf, sizeof(buf));
+      if (n <= 0) {
+        break;
+      }
+      if (!write_all(1, buf, n)) {
+        return 1;
+      }
+    }
+  }
+  close(sock);
+  return 0;
+}
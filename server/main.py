@@ -19,6 +19,7 @@ parser.add_argument('--eval', type = str, help = "path to evaluator", default =
 parser.add_argument('--id', type = str, help = "id for this game", default = gen_game_id())
 parser.add_argument('--verbose', help = "verbose output", action='store_true')
 parser.add_argument('--nodump', help = "do not dump IO", action='store_true')
+parser.add_argument('--persistent', help = "keep one process per player for the whole game (PUNTER_PERSISTENT=1)", action='store_true')
 
 parser.add_argument('--no-futures', help = "disable futures", action='store_true')
 parser.add_argument('--no-options', help = "disable options", action='store_true')
@@ -53,6 +54,55 @@ def communicate_client(cmd, obj, log_stdin = None, log_stdout = None, log_stderr
         print('recv', robj)
     return robj
 
+def read_message(stream):
+    k = b''
+    while True:
+        c = stream.read(1)
+        if not c:
+            raise EOFError('player closed its output')
+        if c == b':':
+            break
+        k += c
+    return stream.read(int(k)).decode('utf-8')
+
+class PersistentClient:
+    """A player process that serves every message of the game; the state stays in the process."""
+
+    def __init__(self, cmd, log_stdin = None, log_stdout = None, log_stderr = None):
+        env = dict(os.environ, PUNTER_PERSISTENT = '1')
+        self.proc = subprocess.Popen(cmd, stdin = subprocess.PIPE, stdout = subprocess.PIPE, stderr = log_stderr, env = env)
+        self.log_stdin = log_stdin
+        self.log_stdout = log_stdout
+        read_message(self.proc.stdout)
+        self.send({ 'you' : 'dummy' })
+
+    def send(self, obj):
+        s = pack(obj)
+        if self.log_stdin:
+            self.log_stdin.write(s + '\n')
+        self.proc.stdin.write(s.encode('utf-8'))
+        self.proc.stdin.flush()
+
+    def communicate(self, obj):
+        if argv.verbose:
+            print('send', obj)
+        self.send(obj)
+        s = read_message(self.proc.stdout)
+        if self.log_stdout:
+            self.log_stdout.write('%d:%s\n' % (len(s), s))
+        robj = json.loads(s)
+        if argv.verbose:
+            print('recv', robj)
+        return robj
+
+    def stop(self, obj):
+        try:
+            self.send(obj)
+            self.proc.stdin.close()
+        except BrokenPipeError:
+            pass
+        self.proc.wait()
+
 def calc_scores(game_id, n, game):
 
     for river in game.game['rivers']:
@@ -92,14 +142,23 @@ def main():
         log_outs = [ open(logpath + ('/%s_%d_%s_stdout.log' % (game_id, i, os.path.basename(p))), 'w') for i,p in enumerate(players) ]
 
 
+    clients = []
     try:
         # setup
         for i, p in enumerate(players):
-            obj = communicate_client(p, { "punter": i, "punters": n, "map" : game.game, "settings": game.settings}
-                                    , log_stdout = log_outs[i]
-                                    , log_stderr = log_errs[i]
-                                    , log_stdin = log_ins[i])
-            game.state[i] = obj["state"]
+            msg = { "punter": i, "punters": n, "map" : game.game, "settings": game.settings}
+            if argv.persistent:
+                clients.append(PersistentClient(p
+                                               , log_stdout = log_outs[i]
+                                               , log_stderr = log_errs[i]
+                                               , log_stdin = log_ins[i]))
+                obj = clients[i].communicate(msg)
+            else:
+                obj = communicate_client(p, msg
+                                        , log_stdout = log_outs[i]
+                                        , log_stderr = log_errs[i]
+                                        , log_stdin = log_ins[i])
+            game.state[i] = obj.get("state")
             if "futures" in obj:
                 game.set_futures(i, obj["futures"])
 
@@ -113,10 +172,13 @@ def main():
             time_start = time.perf_counter()
 
             state = game.state[current]
-            move = communicate_client(p, { 'move' : {'moves' : moves}, 'state': state }
-                                     , log_stdout = log_outs[current]
-                                     , log_stderr = log_errs[current]
-                                     , log_stdin = log_ins[current])
+            if argv.persistent:
+                move = clients[current].communicate({ 'move' : {'moves' : moves} })
+            else:
+                move = communicate_client(p, { 'move' : {'moves' : moves}, 'state': state }
+                                         , log_stdout = log_outs[current]
+                                         , log_stderr = log_errs[current]
+                                         , log_stdin = log_ins[current])
 
             time_end = time.perf_counter()
             times[current].append(int((time_end - time_start) * 1000))
@@ -187,6 +249,8 @@ def main():
                 json.dump( { "setup" : game.game, "punters" : n, "moves" : global_moves }, f )
 
     finally:
+        for client in clients:
+            client.stop({ 'stop' : { 'moves' : [], 'scores' : [] } })
         for l in [log_errs, log_ins, log_outs]:
             for f in l:
                 f.close()
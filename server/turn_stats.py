@@ -0,0 +1,67 @@
+#!/usr/bin/env python3
+"""Aggregates the per-turn lines written with PUNTER_STATS (see lib/TurnStats.h).
+
+e.g.
+  $ PUNTER_STATS=1 python3 main.py ../bin/MCTS ../bin/Greedy2 --map ../maps/tube.json
+  $ python3 turn_stats.py log/*_stderr.log
+
+Lines that are not turn stats (other stderr output of the AIs) are skipped.
+"""
+import argparse
+import json
+from collections import defaultdict
+
+PHASES = ['read', 'decode', 'shortest_distances', 'move', 'encode', 'write']
+COUNTERS = ['evaluate', 'bfs', 'gains']
+
+def load(paths):
+    for path in paths:
+        with open(path, errors='replace') as f:
+            for line in f:
+                if not line.startswith('{'):
+                    continue
+                try:
+                    obj = json.loads(line)
+                except ValueError:
+                    continue
+                if 'time_ms' in obj and 'ai' in obj:
+                    yield obj
+
+def percentile(xs, p):
+    xs = sorted(xs)
+    return xs[min(len(xs) - 1, int(len(xs) * p))]
+
+def mean(xs):
+    return sum(xs) / len(xs)
+
+def main():
+    parser = argparse.ArgumentParser(description='per-AI / per-map latency breakdown of punter turns')
+    parser.add_argument('logs', nargs='+', help='stderr logs or PUNTER_STATS files')
+    parser.add_argument('--setup', help='show setup turns instead of moves', action='store_true')
+    args = parser.parse_args()
+
+    message = 'setup' if args.setup else 'move'
+    groups = defaultdict(list)
+    for obj in load(args.logs):
+        if obj['message'] != message:
+            continue
+        map_key = '%s (V=%d E=%d M=%d)' % (obj['map_hash'][:8], obj['sites'], obj['rivers'], obj['mines'])
+        groups[(obj['ai'], map_key, obj['state'])].append(obj)
+
+    header = ['ai', 'map', 'state', 'turns', 'p50', 'p95', 'max'] + PHASES + COUNTERS
+    rows = []
+    for (ai, map_key, state), objs in sorted(groups.items()):
+        totals = [o['time_ms']['total'] for o in objs]
+        row = [ai, map_key, state, str(len(objs))]
+        row += ['%.2f' % percentile(totals, p) for p in (0.5, 0.95)] + ['%.2f' % max(totals)]
+        row += ['%.2f' % mean([o['time_ms'][ph] for o in objs]) for ph in PHASES]
+        row += ['%.1f' % mean([o['counts'].get(c, 0) for o in objs]) for c in COUNTERS]
+        rows.append(row)
+
+    widths = [max(len(r[i]) for r in [header] + rows) for i in range(len(header))]
+    for r in [header] + rows:
+        print('  '.join(c.ljust(w) if i < 3 else c.rjust(w) for i, (c, w) in enumerate(zip(r, widths))))
+    print('(times in ms; phases and counters are means per turn)')
+
+if __name__ == '__main__':
+    main()
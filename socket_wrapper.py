@@ -78,6 +78,38 @@ def communicate_with_ai(cmd, json_str):
 
   return s
 
+def read_message(stream):
+  res = b""
+  while True:
+    c = stream.read(1)
+    assert(len(c) != 0)
+    if c == b":":
+      break
+    res += c
+  return stream.read(int(res)).decode("utf-8")
+
+class PersistentAI:
+  """Runs the AI once with PUNTER_PERSISTENT=1 and forwards every message to it."""
+  def __init__(self, cmd):
+    env = dict(os.environ, PUNTER_PERSISTENT="1")
+    self.p = Popen(cmd, stdin=PIPE, stdout=PIPE, env=env)
+    read_message(self.p.stdout)
+    self.send(json.dumps({"you": "name"}))
+
+  def send(self, json_str):
+    self.p.stdin.write(str2msg(json_str))
+    self.p.stdin.flush()
+
+  def communicate(self, json_str):
+    self.send(json_str)
+    s = read_message(self.p.stdout)
+    return "{}:{}".format(len(s), s)
+
+  def stop(self, json_str):
+    self.send(json_str)
+    self.p.stdin.close()
+    self.p.wait()
+
 def handshake(sock, name):
   data = {"me": name}
   send_json(sock, data)
@@ -91,6 +123,7 @@ def main():
   parser.add_argument("-n", "--name", type=str, help="user name", default="user_name")
   parser.add_argument("-s", "--server", type=str, help="Server URL", default="punter.inf.ed.ac.uk")
   parser.add_argument("-p", "--port", type=int, required=True, help="port number")
+  parser.add_argument("--persistent", action="store_true", help="keep one AI process for the whole game")
   args = parser.parse_args()
 
   USER_NAME = args.name
@@ -105,23 +138,29 @@ def main():
   print("connected!")
 
   handshake(sock, USER_NAME)
+  ai = PersistentAI(CMD) if args.persistent else None
 
   # Setting Up
   setting_json = recieve_json(sock)
   my_id = setting_json["punter"]
   recv_str= json.dumps(setting_json)
-  ready = communicate_with_ai(CMD, recv_str)
+  ready = ai.communicate(recv_str) if ai else communicate_with_ai(CMD, recv_str)
   send_str(sock, ready)
 
   # Game
   while True:
     recv_json = recieve_json(sock)
     if "stop" in recv_json:
+      if ai:
+        ai.stop(json.dumps(recv_json))
       break
 
-    recv_json["state"] = g_game_state
-    recv_str= json.dumps(recv_json)
-    move = communicate_with_ai(CMD, recv_str)
+    if ai:
+      move = ai.communicate(json.dumps(recv_json))
+    else:
+      recv_json["state"] = g_game_state
+      recv_str= json.dumps(recv_json)
+      move = communicate_with_ai(CMD, recv_str)
     send_str(sock, move)
 
   sock.close()